@@ -0,0 +1,443 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <boost/thread.hpp>
+
+#include "Galacticus_Aggregates.h"
+#include "Galacticus_RadixSort.h"
+#include "galacticusingest_error.h"
+
+// below this number of rows, threads are not worth it
+#define AGGREGATE_MINPARALLEL 1000000
+// largest grid, so that cell numbers fit into 64 bits
+#define AGGREGATE_MAXGRID 2097152
+
+namespace Galacticus {
+
+    AggregateSpec::AggregateSpec() {
+        kind = AGG_COUNT;
+        min = 0;
+        max = 0;
+        nbins = 0;
+        logBins = false;
+        ngrid = 0;
+        boxSize = 0;
+    }
+
+    AggregateSpec::AggregateSpec(string newSpec) {
+        vector<string> tokens;
+        string token;
+        stringstream ss(newSpec);
+        string msg = "Invalid aggregate " + newSpec + ", expected file:count, file:sum:column, file:hist:column:min:max:nbins[:log] or file:grid:ngrid:boxSize[:column].";
+        bool valid = true;
+
+        spec = newSpec;
+        min = 0;
+        max = 0;
+        nbins = 0;
+        logBins = false;
+        ngrid = 0;
+        boxSize = 0;
+
+        while (getline(ss, token, ':')) {
+            tokens.push_back(token);
+        }
+        if (tokens.size() < 2 || tokens[0] == "") {
+            GalacticusIngest_error(msg.c_str());
+        }
+        csvFile = tokens[0];
+
+        if (tokens[1] == "count" && tokens.size() == 2) {
+            kind = AGG_COUNT;
+        } else if (tokens[1] == "sum" && tokens.size() == 3) {
+            kind = AGG_SUM;
+            columns.push_back(tokens[2]);
+        } else if (tokens[1] == "hist" && (tokens.size() == 6 || tokens.size() == 7)) {
+            kind = AGG_HISTOGRAM;
+            columns.push_back(tokens[2]);
+            min = atof(tokens[3].c_str());
+            max = atof(tokens[4].c_str());
+            nbins = atoi(tokens[5].c_str());
+            if (tokens.size() == 7) {
+                logBins = (tokens[6] == "log");
+                valid = logBins;
+            }
+            valid = valid && (nbins > 0 && min < max && (!logBins || min > 0));
+        } else if (tokens[1] == "grid" && (tokens.size() == 4 || tokens.size() == 5)) {
+            kind = AGG_GRID;
+            ngrid = atoi(tokens[2].c_str());
+            boxSize = atof(tokens[3].c_str());
+            // cell numbers from the converted positions, as for ix, iy, iz
+            columns.push_back("positionPositionX");
+            columns.push_back("positionPositionY");
+            columns.push_back("positionPositionZ");
+            if (tokens.size() == 5) {
+                columns.push_back(tokens[4]);
+            }
+            valid = (ngrid > 0 && ngrid <= AGGREGATE_MAXGRID && boxSize > 0);
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            GalacticusIngest_error(msg.c_str());
+        }
+    }
+
+
+    AggregateCell::AggregateCell() {
+        count = 0;
+        sum = 0;
+    }
+
+
+    AggregateResult::AggregateResult() {
+        count = 0;
+        sum = 0;
+        min = 0;
+        max = 0;
+    }
+
+    void AggregateResult::merge(const AggregateResult &other) {
+        if (other.count > 0) {
+            if (count == 0 || other.min < min) {
+                min = other.min;
+            }
+            if (count == 0 || other.max > max) {
+                max = other.max;
+            }
+        }
+        count += other.count;
+        sum += other.sum;
+
+        if (histogram.size() < other.histogram.size()) {
+            histogram.resize(other.histogram.size(), 0);
+        }
+        for (size_t b=0; b<other.histogram.size(); b++) {
+            histogram[b] += other.histogram[b];
+        }
+
+        for (map<unsigned long, AggregateCell>::const_iterator it = other.cells.begin(); it != other.cells.end(); it++) {
+            AggregateCell &c = cells[it->first];
+            c.count += it->second.count;
+            c.sum += it->second.sum;
+        }
+    }
+
+
+    // one part of the rows of an output, handled by one thread with its own result
+    class AggregatePart {
+        public:
+            const AggregateSpec *spec;
+            const vector<const double*> *columns;
+            unsigned long *keys;
+            long start;
+            long end;
+            AggregateResult result;
+
+            void run() {
+                const double *values = (columns->size() > 0) ? (*columns)[0] : NULL;
+                double v;
+
+                if (spec->kind == AGG_COUNT) {
+                    result.count = end - start;
+
+                } else if (spec->kind == AGG_SUM) {
+                    for (long i=start; i<end; i++) {
+                        v = values[i];
+                        if (v != v) {
+                            continue;
+                        }
+                        if (result.count == 0 || v < result.min) {
+                            result.min = v;
+                        }
+                        if (result.count == 0 || v > result.max) {
+                            result.max = v;
+                        }
+                        result.count++;
+                        result.sum += v;
+                    }
+
+                } else if (spec->kind == AGG_HISTOGRAM) {
+                    double lo = spec->logBins ? log10(spec->min) : spec->min;
+                    double hi = spec->logBins ? log10(spec->max) : spec->max;
+                    double binsPerUnit = spec->nbins / (hi - lo);
+                    long bin;
+
+                    result.histogram.assign(spec->nbins, 0);
+                    for (long i=start; i<end; i++) {
+                        v = values[i];
+                        if (spec->logBins) {
+                            if (!(v > 0)) {
+                                continue;
+                            }
+                            v = log10(v);
+                        }
+                        // NaN and values outside [min, max) are not counted
+                        if (!(v >= lo && v < hi)) {
+                            continue;
+                        }
+                        bin = (long) ((v - lo) * binsPerUnit);
+                        if (bin >= spec->nbins) {
+                            bin = spec->nbins - 1;
+                        }
+                        result.histogram[bin]++;
+                    }
+
+                } else if (spec->kind == AGG_GRID) {
+                    // cell number of each row, NaN positions get the largest key;
+                    // positions outside the box are put into the border cells
+                    double cellsPerUnit = spec->ngrid / spec->boxSize;
+                    long c[3];
+                    bool nan;
+
+                    for (long i=start; i<end; i++) {
+                        nan = false;
+                        for (int d=0; d<3; d++) {
+                            v = (*columns)[d][i];
+                            if (v != v) {
+                                nan = true;
+                                break;
+                            }
+                            v *= cellsPerUnit;
+                            if (v < 0) {
+                                c[d] = 0;
+                            } else if (v >= spec->ngrid) {
+                                c[d] = spec->ngrid - 1;
+                            } else {
+                                c[d] = (long) v;
+                            }
+                        }
+                        if (nan) {
+                            keys[i] = ~0UL;
+                        } else {
+                            keys[i] = ((unsigned long) c[0] * spec->ngrid + c[1]) * spec->ngrid + c[2];
+                        }
+                    }
+                }
+            }
+    };
+
+    class AggregateTask {
+        private:
+            AggregatePart *part;
+        public:
+            AggregateTask(AggregatePart *newPart) {
+                part = newPart;
+            }
+            void operator()() {
+                part->run();
+            }
+    };
+
+
+    Aggregator::Aggregator() {
+        fileNum = 0;
+        nthreads = 1;
+        written = false;
+    }
+
+    Aggregator::Aggregator(int newFileNum, int newNumThreads) {
+        fileNum = newFileNum;
+        nthreads = newNumThreads;
+        if (nthreads < 1) {
+            nthreads = 1;
+        }
+        written = false;
+    }
+
+    Aggregator::~Aggregator() {
+        if (!written) {
+            write();
+        }
+    }
+
+    void Aggregator::addAggregate(string spec) {
+        AggregateSpec a(spec);
+        for (size_t i=0; i<specs.size(); i++) {
+            if (specs[i].csvFile == a.csvFile) {
+                string msg = "Aggregates " + specs[i].spec + " and " + spec + " use the same file.";
+                GalacticusIngest_error(msg.c_str());
+            }
+        }
+        specs.push_back(a);
+    }
+
+    int Aggregator::getNumAggregates() {
+        return specs.size();
+    }
+
+    vector<string> Aggregator::getColumns(int i) {
+        return specs[i].columns;
+    }
+
+    void Aggregator::addOutput(int i, int snapnum, long n, const vector<const double*> &columns) {
+        int numParts = nthreads;
+        vector<unsigned long> keys;
+        AggregateResult result;
+
+        if (n < AGGREGATE_MINPARALLEL) {
+            numParts = 1;
+        }
+        if (specs[i].kind == AGG_GRID) {
+            keys.resize(n);
+        }
+
+        vector<AggregatePart> parts(numParts);
+        for (int t=0; t<numParts; t++) {
+            parts[t].spec = &specs[i];
+            parts[t].columns = &columns;
+            parts[t].keys = (n > 0 && keys.size() > 0) ? &keys[0] : NULL;
+            parts[t].start = (n * t) / numParts;
+            parts[t].end = (n * (t+1)) / numParts;
+        }
+
+        if (numParts == 1) {
+            parts[0].run();
+        } else {
+            boost::thread_group threads;
+            for (int t=0; t<numParts; t++) {
+                threads.create_thread(AggregateTask(&parts[t]));
+            }
+            threads.join_all();
+        }
+
+        for (int t=0; t<numParts; t++) {
+            result.merge(parts[t].result);
+        }
+
+        if (specs[i].kind == AGG_GRID && n > 0) {
+            // sort the rows by cell, then each cell is one run of keys
+            vector<long> rows(n);
+            const double *weights = (columns.size() > 3) ? columns[3] : NULL;
+            map<unsigned long, AggregateCell>::iterator cell = result.cells.end();
+
+            for (long r=0; r<n; r++) {
+                rows[r] = r;
+            }
+            radixSortRows(keys, rows, nthreads);
+
+            for (long r=0; r<n && keys[r] != ~0UL; r++) {
+                if (cell == result.cells.end() || cell->first != keys[r]) {
+                    cell = result.cells.insert(result.cells.end(), make_pair(keys[r], AggregateCell()));
+                }
+                cell->second.count++;
+                if (weights && weights[rows[r]] == weights[rows[r]]) {
+                    cell->second.sum += weights[rows[r]];
+                }
+                result.count++;
+            }
+        }
+
+        vector<AggregateResult> &r = results[snapnum];
+        r.resize(specs.size());
+        r[i].merge(result);
+    }
+
+    void Aggregator::write() {
+        // one CSV file per aggregation, one line per snapnum (and bin or cell)
+        ofstream out;
+        map<int, vector<AggregateResult> >::iterator it;
+        AggregateSpec *s;
+        double lo;
+        double hi;
+        unsigned long ng;
+
+        written = true;
+
+        for (size_t i=0; i<specs.size(); i++) {
+            s = &specs[i];
+            out.open(s->csvFile.c_str(), ios::out | ios::trunc);
+            if (!out) {
+                cout << "ERROR: Cannot write aggregate " << s->spec << " to file " << s->csvFile << endl;
+                continue;
+            }
+            out.precision(10);
+
+            if (s->kind == AGG_COUNT) {
+                out << "fileNum,snapnum,count" << endl;
+            } else if (s->kind == AGG_SUM) {
+                out << "fileNum,snapnum,count,sum,min,max" << endl;
+            } else if (s->kind == AGG_HISTOGRAM) {
+                out << "fileNum,snapnum,bin,lower,upper,count" << endl;
+            } else {
+                out << "fileNum,snapnum,ix,iy,iz,count";
+                if (s->columns.size() > 3) {
+                    out << ",sum";
+                }
+                out << endl;
+            }
+
+            for (it = results.begin(); it != results.end(); it++) {
+                if (it->second.size() <= i) {
+                    continue;
+                }
+                AggregateResult &r = it->second[i];
+
+                if (s->kind == AGG_COUNT) {
+                    out << fileNum << "," << it->first << "," << r.count << endl;
+
+                } else if (s->kind == AGG_SUM) {
+                    out << fileNum << "," << it->first << "," << r.count << "," << r.sum << ",";
+                    if (r.count > 0) {
+                        out << r.min << "," << r.max;
+                    } else {
+                        out << ",";
+                    }
+                    out << endl;
+
+                } else if (s->kind == AGG_HISTOGRAM) {
+                    for (int b=0; b<s->nbins; b++) {
+                        if (s->logBins) {
+                            lo = pow(10., log10(s->min) + b * (log10(s->max) - log10(s->min)) / s->nbins);
+                            hi = pow(10., log10(s->min) + (b+1) * (log10(s->max) - log10(s->min)) / s->nbins);
+                        } else {
+                            lo = s->min + b * (s->max - s->min) / s->nbins;
+                            hi = s->min + (b+1) * (s->max - s->min) / s->nbins;
+                        }
+                        out << fileNum << "," << it->first << "," << b << "," << lo << "," << hi << ","
+                            << ((b < (int) r.histogram.size()) ? r.histogram[b] : 0) << endl;
+                    }
+
+                } else {
+                    ng = s->ngrid;
+                    for (map<unsigned long, AggregateCell>::iterator c = r.cells.begin(); c != r.cells.end(); c++) {
+                        out << fileNum << "," << it->first << "," << c->first / (ng * ng) << "," << (c->first / ng) % ng << "," << c->first % ng
+                            << "," << c->second.count;
+                        if (s->columns.size() > 3) {
+                            out << "," << c->second.sum;
+                        }
+                        out << endl;
+                    }
+                }
+            }
+
+            out.close();
+            printf("Aggregate %s written to %s\n", s->spec.c_str(), s->csvFile.c_str());
+        }
+        fflush(stdout);
+    }
+
+}
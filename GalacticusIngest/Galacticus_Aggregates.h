@@ -0,0 +1,110 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifndef Galacticus_Galacticus_Aggregates_h
+#define Galacticus_Galacticus_Aggregates_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    enum AggregateKind { AGG_COUNT, AGG_SUM, AGG_HISTOGRAM, AGG_GRID };
+
+    // one aggregation, given as csvFile:kind:..., i.e.
+    //   file.csv:count                                  rows per snapnum
+    //   file.csv:sum:column                             count, sum, min, max per snapnum
+    //   file.csv:hist:column:min:max:nbins[:log]        histogram per snapnum
+    //   file.csv:grid:ngrid:boxSize[:column]            count (and sum) per (ix,iy,iz) cell
+    class AggregateSpec {
+        public:
+            string spec;
+            string csvFile;
+            AggregateKind kind;
+            vector<string> columns;     // columns needed, in this order
+            double min;
+            double max;
+            int nbins;
+            bool logBins;
+            int ngrid;
+            double boxSize;
+
+            AggregateSpec();
+            AggregateSpec(string newSpec);
+    };
+
+    class AggregateCell {
+        public:
+            long count;
+            double sum;
+
+            AggregateCell();
+    };
+
+    // result of one aggregation for one snapnum
+    class AggregateResult {
+        public:
+            long count;
+            double sum;
+            double min;
+            double max;
+            vector<long> histogram;
+            map<unsigned long, AggregateCell> cells;
+
+            AggregateResult();
+            void merge(const AggregateResult &other);
+    };
+
+
+    // Evaluates aggregations on the (unit converted) column values of each
+    // output while it is ingested, so that counts per snapnum, mass functions
+    // or counts per grid cell need no scan of the table afterwards. Large
+    // outputs are split into parts with one accumulator per thread, which
+    // are merged afterwards. The results are written as CSV files.
+    class Aggregator {
+        private:
+            vector<AggregateSpec> specs;
+            int fileNum;
+            int nthreads;
+            map<int, vector<AggregateResult> > results;    // snapnum -> per aggregation
+            bool written;
+
+            void addGridCells(AggregateSpec &spec, AggregateResult &result, long n, const vector<const double*> &columns);
+
+        public:
+            Aggregator();
+            Aggregator(int newFileNum, int newNumThreads);
+            ~Aggregator();
+
+            void addAggregate(string spec);
+            int getNumAggregates();
+            vector<string> getColumns(int i);
+
+            // aggregate n rows of one output; columns as given by getColumns
+            // (NaN for NULL values, which are skipped)
+            void addOutput(int i, int snapnum, long n, const vector<const double*> &columns);
+            void write();
+    };
+
+}
+
+#endif
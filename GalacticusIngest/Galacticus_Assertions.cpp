@@ -0,0 +1,215 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include "Galacticus_Assertions.h"
+#include "galacticusingest_error.h"
+
+namespace Galacticus {
+
+    ColumnAssertion::ColumnAssertion() {
+        kind = ASSERT_FINITE;
+        minval = 0;
+        maxval = 0;
+        action = ACTION_FAIL;
+    }
+
+    ColumnAssertion::ColumnAssertion(string newColumn, string newSpec) {
+        // spec is kind:action, the kind range has its limits in brackets
+        string::size_type pos = newSpec.rfind(':');
+        string kindStr;
+        string actionStr;
+        char rest;
+
+        column = newColumn;
+        spec = newSpec;
+        minval = 0;
+        maxval = 0;
+
+        if (pos == string::npos) {
+            string msg = "Assertion '" + newSpec + "' for " + column + " must be given as kind:action.";
+            GalacticusIngest_error(msg.c_str());
+        }
+        kindStr = newSpec.substr(0, pos);
+        actionStr = newSpec.substr(pos + 1);
+
+        if (kindStr.compare("finite") == 0) {
+            kind = ASSERT_FINITE;
+        } else if (kindStr.compare("nonneg") == 0) {
+            kind = ASSERT_NONNEGATIVE;
+        } else if (kindStr.compare("increasing") == 0) {
+            kind = ASSERT_INCREASING;
+        } else if (sscanf(kindStr.c_str(), "range(%lf,%lf%c", &minval, &maxval, &rest) == 3 && rest == ')'
+                   && kindStr[kindStr.length()-1] == ')' && minval <= maxval) {
+            kind = ASSERT_RANGE;
+        } else {
+            string msg = "Unknown assertion '" + kindStr + "' for " + column + " (use range(min,max), finite, nonneg or increasing).";
+            GalacticusIngest_error(msg.c_str());
+        }
+
+        if (actionStr.compare("null") == 0) {
+            action = ACTION_NULL;
+        } else if (actionStr.compare("clamp") == 0) {
+            action = ACTION_CLAMP;
+        } else if (actionStr.compare("drop") == 0) {
+            action = ACTION_DROP;
+        } else if (actionStr.compare("fail") == 0) {
+            action = ACTION_FAIL;
+        } else {
+            string msg = "Unknown action '" + actionStr + "' for " + column + " (use null, clamp, drop or fail).";
+            GalacticusIngest_error(msg.c_str());
+        }
+
+        if (action == ACTION_CLAMP && kind == ASSERT_INCREASING) {
+            string msg = "Values of " + column + " cannot be clamped for assertion increasing.";
+            GalacticusIngest_error(msg.c_str());
+        }
+    }
+
+
+    BlockAsserter::BlockAsserter() {
+    }
+
+    void BlockAsserter::addAssertion(string column, string spec) {
+        assertions.push_back(ColumnAssertion(column, spec));
+    }
+
+    int BlockAsserter::getNumAssertions() {
+        return assertions.size();
+    }
+
+    ColumnAssertion &BlockAsserter::getAssertion(int i) {
+        return assertions[i];
+    }
+
+    // comparisons with NaN are false, so NaN only violates finite (and
+    // range/nonneg, where it cannot be clamped and becomes NULL instead)
+    static inline bool isFinite(double v) {
+        return (v == v && v <= DBL_MAX && v >= -DBL_MAX);
+    }
+
+    static inline bool isFinite(long v) {
+        return true;
+    }
+
+    template <class T> long BlockAsserter::checkValues(ColumnAssertion &a, T *values, long first, const vector<long> &rows, char *nulls, vector<char> &drop) {
+        long n = rows.size();
+        long violations = 0;
+        long row;
+        bool bad = false;
+        T v;
+        T last = 0;
+        bool haveLast = false;
+
+        for (long i=0; i<n; i++) {
+            row = rows[i];
+            v = values[row - first];
+            switch (a.kind) {
+                case ASSERT_RANGE:
+                    bad = !(v >= a.minval && v <= a.maxval);
+                    break;
+                case ASSERT_FINITE:
+                    bad = !isFinite(v);
+                    break;
+                case ASSERT_NONNEGATIVE:
+                    bad = !(v >= 0);
+                    break;
+                case ASSERT_INCREASING:
+                    bad = (haveLast && !(v > last));
+                    if (!bad) {
+                        last = v;
+                        haveLast = true;
+                    }
+                    break;
+            }
+            if (!bad) {
+                continue;
+            }
+
+            violations++;
+            if (a.action == ACTION_CLAMP && v == v) {
+                if (a.kind == ASSERT_RANGE) {
+                    values[row - first] = (v < a.minval) ? (T) a.minval : (T) a.maxval;
+                } else if (a.kind == ASSERT_NONNEGATIVE) {
+                    values[row - first] = 0;
+                } else {
+                    values[row - first] = (v > 0) ? (T) DBL_MAX : (T) -DBL_MAX;
+                }
+            } else if (a.action == ACTION_CLAMP || a.action == ACTION_NULL) {
+                nulls[row - first] = 1;
+            } else if (a.action == ACTION_DROP) {
+                drop[row] = 1;
+            }
+        }
+        return violations;
+    }
+
+    long BlockAsserter::check(int i, int snapnum, double *doubleval, long *longval, long first, const vector<long> &rows, char *nulls, vector<char> &drop) {
+        long violations;
+        if (doubleval) {
+            violations = checkValues(assertions[i], doubleval, first, rows, nulls, drop);
+        } else {
+            violations = checkValues(assertions[i], longval, first, rows, nulls, drop);
+        }
+
+        vector<long> &c = counts[snapnum];
+        c.resize(assertions.size(), 0);
+        c[i] += violations;
+        return violations;
+    }
+
+    void BlockAsserter::addFailedOutput(int snapnum) {
+        failedSnapnums.push_back(snapnum);
+    }
+
+    int BlockAsserter::getNumFailedOutputs() {
+        return failedSnapnums.size();
+    }
+
+    void BlockAsserter::printReport() {
+        // violations per column and snapnum, only non-zero counts
+        map<int, vector<long> >::iterator it;
+        long total = 0;
+
+        printf("Assertions: violations per snapnum and column\n");
+        for (it = counts.begin(); it != counts.end(); it++) {
+            for (size_t i=0; i<it->second.size(); i++) {
+                if (it->second[i] > 0) {
+                    printf("  snapnum %4d  %-30s %-30s %ld\n", it->first, assertions[i].column.c_str(), assertions[i].spec.c_str(), it->second[i]);
+                    total += it->second[i];
+                }
+            }
+        }
+        printf("Assertions: %ld violations in total", total);
+        if (failedSnapnums.size() > 0) {
+            printf(", failed snapnums:");
+            for (size_t i=0; i<failedSnapnums.size(); i++) {
+                printf(" %d", failedSnapnums[i]);
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+}
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifndef Galacticus_Galacticus_Assertions_h
+#define Galacticus_Galacticus_Assertions_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    enum AssertionKind { ASSERT_RANGE, ASSERT_FINITE, ASSERT_NONNEGATIVE, ASSERT_INCREASING };
+    enum AssertionAction { ACTION_NULL, ACTION_CLAMP, ACTION_DROP, ACTION_FAIL };
+
+    // one assertion on a column, declared in the field map after the four
+    // columns, e.g. assert=range(1e6,1e16):clamp, assert=finite:null,
+    // assert=nonneg:drop, assert=increasing:fail
+    class ColumnAssertion {
+        public:
+            string column;
+            string spec;
+            AssertionKind kind;
+            double minval;
+            double maxval;
+            AssertionAction action;
+
+            ColumnAssertion();
+            ColumnAssertion(string newColumn, string newSpec);
+    };
+
+
+    // Checks the assertions for the values of one output, column by column
+    // in tight loops over the (selected) rows, right after the datasets were
+    // read. Violations are counted per column and snapnum.
+    class BlockAsserter {
+        private:
+            vector<ColumnAssertion> assertions;
+            map<int, vector<long> > counts;     // snapnum -> violations per assertion
+            vector<int> failedSnapnums;
+
+            template <class T> long checkValues(ColumnAssertion &a, T *values, long first, const vector<long> &rows, char *nulls, vector<char> &drop);
+
+        public:
+            BlockAsserter();
+
+            void addAssertion(string column, string spec);
+            int getNumAssertions();
+            ColumnAssertion &getAssertion(int i);
+
+            // check assertion i for the given rows, apply its action: change
+            // values (clamp), set null flags, mark rows to be dropped; returns
+            // the number of violations (the output fails for action fail);
+            // values and null flags start with the given row of the output
+            long check(int i, int snapnum, double *doubleval, long *longval, long first, const vector<long> &rows, char *nulls, vector<char> &drop);
+            void addFailedOutput(int snapnum);
+            int getNumFailedOutputs();
+
+            void printReport();
+    };
+
+}
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <math.h>
+
+#include "Galacticus_BatchTuner.h"
+
+namespace Galacticus {
+
+    BatchTuner::BatchTuner() {
+        bufferSize = 128;
+        minBufferSize = 16;
+        maxBufferSize = 8192;
+        batchesPerSegment = 50;
+        step = 1.5;
+        direction = 1;
+        lastRate = 0;
+        tolerance = 0.02;
+        settled = false;
+        reversed = false;
+        settledRate = 0;
+        bestSize = 0;
+        bestRate = 0;
+        totalRows = 0;
+        totalSeconds = 0;
+    }
+
+    BatchTuner::BatchTuner(uint32_t startSize, uint32_t newMinBufferSize, uint32_t newMaxBufferSize, int newBatchesPerSegment) {
+        minBufferSize = newMinBufferSize;
+        maxBufferSize = newMaxBufferSize;
+        if (minBufferSize < 1) {
+            minBufferSize = 1;
+        }
+        if (maxBufferSize < minBufferSize) {
+            maxBufferSize = minBufferSize;
+        }
+
+        bufferSize = startSize;
+        if (bufferSize < minBufferSize) {
+            bufferSize = minBufferSize;
+        }
+        if (bufferSize > maxBufferSize) {
+            bufferSize = maxBufferSize;
+        }
+
+        batchesPerSegment = newBatchesPerSegment;
+        if (batchesPerSegment < 1) {
+            batchesPerSegment = 1;
+        }
+
+        step = 1.5;
+        direction = 1;
+        lastRate = 0;
+        tolerance = 0.02;
+        settled = false;
+        reversed = false;
+        settledRate = 0;
+        bestSize = 0;
+        bestRate = 0;
+        totalRows = 0;
+        totalSeconds = 0;
+    }
+
+    uint32_t BatchTuner::getBufferSize() {
+        return bufferSize;
+    }
+
+    long BatchTuner::getSegmentRows() {
+        // measure always the same number of batches, so that
+        // the fixed costs per segment weigh the same for each size
+        return (long) batchesPerSegment * bufferSize;
+    }
+
+    uint32_t BatchTuner::update(long rows, double seconds) {
+        // take the measurement for the current buffer size and
+        // return the buffer size for the next segment
+        double rate;
+        double latency;
+        long nbatches;
+        uint32_t oldSize = bufferSize;
+        double newSize;
+
+        if (rows <= 0 || seconds <= 0) {
+            return bufferSize;
+        }
+
+        rate = rows / seconds;
+        nbatches = (rows + bufferSize - 1) / bufferSize;
+        latency = 1000. * seconds / nbatches;
+
+        totalRows += rows;
+        totalSeconds += seconds;
+        sizeHistory.push_back(bufferSize);
+        rateHistory.push_back(rate);
+
+        if (settled) {
+            // keep the size while the rate stays within the tolerance of the
+            // rate measured with it, otherwise start probing again from here
+            if (settledRate <= 0) {
+                settledRate = rate;
+            } else if (fabs(rate - settledRate) > settledRate * tolerance) {
+                settled = false;
+                reversed = false;
+                step = 1.5;
+                lastRate = 0;
+                settledRate = 0;
+                bestRate = 0;
+            }
+        }
+
+        if (!settled) {
+            if (rate > bestRate) {
+                bestRate = rate;
+                bestSize = bufferSize;
+            }
+
+            if (lastRate > 0) {
+                if (rate > lastRate * (1 + tolerance)) {
+                    // last change was good, go on (and be a bit bolder,
+                    // as long as the optimum was not passed yet)
+                    if (!reversed) {
+                        step = step * 1.25;
+                        if (step > 2) {
+                            step = 2;
+                        }
+                    }
+                } else if (rate < lastRate * (1 - tolerance) && step > 1.05) {
+                    // last change was bad, turn around with a smaller step
+                    direction = -direction;
+                    reversed = true;
+                    step = sqrt(step);
+                    if (step < 1.05) {
+                        step = 1.05;
+                    }
+                } else {
+                    // no significant change, or no smaller step left
+                    settled = true;
+                }
+            }
+            lastRate = rate;
+        }
+
+        if (!settled) {
+            if (direction > 0) {
+                newSize = bufferSize * step;
+            } else {
+                newSize = bufferSize / step;
+            }
+            if (newSize < minBufferSize) {
+                newSize = minBufferSize;
+                direction = 1;
+            }
+            if (newSize > maxBufferSize) {
+                newSize = maxBufferSize;
+                direction = -1;
+            }
+            // at a limit already, nothing left to try
+            if ((uint32_t) (newSize + 0.5) == bufferSize) {
+                settled = true;
+            }
+        }
+
+        if (settled) {
+            if (bufferSize != bestSize && bestSize > 0) {
+                // go back to the best size seen while probing, and take
+                // its rate as reference with the next measurement
+                settledRate = 0;
+                bufferSize = bestSize;
+            } else if (settledRate <= 0) {
+                settledRate = rate;
+            }
+        } else {
+            bufferSize = (uint32_t) (newSize + 0.5);
+        }
+
+        printf("Auto-tuning: buffer size %u: %ld rows in %.3f s (%.0f rows/s, %.2f ms per batch) -> next buffer size %u\n",
+               oldSize, rows, seconds, rate, latency, bufferSize);
+        fflush(stdout);
+
+        return bufferSize;
+    }
+
+    void BatchTuner::printSummary() {
+        int ibest = -1;
+        for (size_t i=0; i<rateHistory.size(); i++) {
+            if (ibest < 0 || rateHistory[i] > rateHistory[ibest]) {
+                ibest = i;
+            }
+        }
+
+        printf("Auto-tuning summary: %ld rows in %.3f s in %ld segments", totalRows, totalSeconds, (long) rateHistory.size());
+        if (totalSeconds > 0) {
+            printf(", mean %.0f rows/s", totalRows / totalSeconds);
+        }
+        if (ibest >= 0) {
+            printf(", best buffer size %u (%.0f rows/s)", sizeHistory[ibest], rateHistory[ibest]);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+}
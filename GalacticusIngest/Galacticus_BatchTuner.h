@@ -0,0 +1,76 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdint.h>
+#include <vector>
+
+#ifndef Galacticus_Galacticus_BatchTuner_h
+#define Galacticus_Galacticus_BatchTuner_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // Simple feedback controller for the ingest buffer size (rows per batch):
+    // the ingest is done in segments of a fixed number of batches, and after
+    // each segment the throughput is compared with the previous one. The
+    // buffer size is changed by a factor in the current direction as long as
+    // the throughput improves, otherwise the direction is reversed and the
+    // step is reduced. The step grows while the first direction keeps paying
+    // off; after a reversal, the optimum is narrowed down with shrinking steps.
+    // When a change makes no significant difference (or the smallest step
+    // did not help), the best size seen so far is kept; probing starts again
+    // only when the rate with that size moves beyond the tolerance, so that
+    // a drifting optimum is followed.
+    class BatchTuner {
+        private:
+            uint32_t bufferSize;
+            uint32_t minBufferSize;
+            uint32_t maxBufferSize;
+            int batchesPerSegment;
+
+            double step;        // factor for changing the buffer size
+            int direction;      // +1: increase, -1: decrease
+            double lastRate;    // rows per second of the previous segment
+            double tolerance;   // relative change of rate regarded as noise
+            bool settled;       // keeping the current size, not probing
+            bool reversed;      // direction was reversed since probing started
+            double settledRate; // reference rate of the kept size (0 = not measured yet)
+            uint32_t bestSize;  // best size and rate since probing started
+            double bestRate;
+
+            long totalRows;
+            double totalSeconds;
+            vector<uint32_t> sizeHistory;
+            vector<double> rateHistory;
+
+        public:
+            BatchTuner();
+            BatchTuner(uint32_t startSize, uint32_t newMinBufferSize, uint32_t newMaxBufferSize, int newBatchesPerSegment);
+
+            uint32_t getBufferSize();
+            long getSegmentRows();
+
+            uint32_t update(long rows, double seconds);
+            void printSummary();
+    };
+
+}
+
+#endif
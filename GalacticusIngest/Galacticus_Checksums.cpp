@@ -0,0 +1,374 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef DB_MYSQL
+#include <mysql.h>
+#endif
+
+#include "Galacticus_Checksums.h"
+#include "Galacticus_Stats.h"
+#include "Galacticus_Daemon.h"
+
+namespace Galacticus {
+
+    ColumnChecksum::ColumnChecksum() {
+        rows = 0;
+        nonNull = 0;
+        sum = 0;
+        sumAbs = 0;
+        xorBits = 0;
+    }
+
+    ColumnChecksum::ColumnChecksum(string newColumn, string newDType) {
+        column = newColumn;
+        dtype = newDType;
+        rows = 0;
+        nonNull = 0;
+        sum = 0;
+        sumAbs = 0;
+        xorBits = 0;
+    }
+
+    static bool isIntegerDType(DBDataSchema::DType dtype) {
+        return (dtype != DBDataSchema::DT_REAL4 && dtype != DBDataSchema::DT_REAL8);
+    }
+
+    static long getValueAsLong(DBDataSchema::DType dtype, void *value) {
+        switch (dtype) {
+            case DBDataSchema::DT_INT1:
+                return *(char*) value;
+            case DBDataSchema::DT_INT2:
+                return *(short*) value;
+            case DBDataSchema::DT_INT4:
+                return *(int*) value;
+            case DBDataSchema::DT_UINT1:
+                return *(unsigned char*) value;
+            case DBDataSchema::DT_UINT2:
+                return *(unsigned short*) value;
+            case DBDataSchema::DT_UINT4:
+                return *(unsigned int*) value;
+            default:
+                return *(long*) value;
+        }
+    }
+
+
+    ChecksumCollector::ChecksumCollector() {
+        fileNum = 0;
+        dbIdIndex = -1;
+        current_snapnum = -1;
+        current = NULL;
+        written = false;
+    }
+
+    ChecksumCollector::ChecksumCollector(string newChecksumFile, int newFileNum, DBDataSchema::Schema *schema) {
+        DBDataSchema::DataObjDesc *item;
+
+        checksumFile = newChecksumFile;
+        fileNum = newFileNum;
+        dbIdIndex = -1;
+
+        for (size_t i=0; i<schema->getArrSchemaItems().size(); i++) {
+            item = schema->getArrSchemaItems().at(i)->getDataDesc();
+            if (item->getDataObjName().compare("dbId") == 0) {
+                dbIdIndex = items.size();
+            }
+            items.add(item);
+            columnNames.push_back(schema->getArrSchemaItems().at(i)->getColumnName());
+        }
+
+        current_snapnum = -1;
+        current = NULL;
+        written = false;
+    }
+
+    ChecksumCollector::~ChecksumCollector() {
+        if (!written) {
+            write();
+        }
+    }
+
+    void ChecksumCollector::addValue(DBDataSchema::DataObjDesc *item, int snapnum, bool isNull, void *value) {
+        int i = items.find(item); // -1: not part of the schema, ignored
+        double v;
+        long l;
+
+        if (i < 0) {
+            return;
+        }
+
+        if (snapnum != current_snapnum || !current) {
+            current_snapnum = snapnum;
+            current = &results[snapnum];
+            if (current->size() == 0) {
+                for (size_t k=0; k<items.size(); k++) {
+                    current->push_back(ColumnChecksum(columnNames[k], isIntegerDType(items[k]->getDataObjDType()) ? "int" : "real"));
+                }
+            }
+        }
+
+        ColumnChecksum &c = (*current)[i];
+        c.rows++;
+        if (isNull) {
+            return;
+        }
+
+        if (isIntegerDType(item->getDataObjDType())) {
+            l = getValueAsLong(item->getDataObjDType(), value);
+            c.nonNull++;
+            c.sum += (double) l;
+            c.sumAbs += fabs((double) l);
+            c.xorBits ^= (unsigned long) l;
+            if (i == dbIdIndex) {
+                if (minDbId.find(snapnum) == minDbId.end() || l < minDbId[snapnum]) {
+                    minDbId[snapnum] = l;
+                }
+                if (maxDbId.find(snapnum) == maxDbId.end() || l > maxDbId[snapnum]) {
+                    maxDbId[snapnum] = l;
+                }
+            }
+        } else {
+            v = getValueAsDouble(item->getDataObjDType(), value);
+            if (v != v || fabs(v) > 1.7976931348623157e308) {
+                return;
+            }
+            c.nonNull++;
+            c.sum += v;
+            c.sumAbs += fabs(v);
+        }
+    }
+
+    void ChecksumCollector::write() {
+        // one line per snapnum and column
+        FILE *f;
+
+        written = true;
+
+        if (dbIdIndex < 0) {
+            cout << "WARNING: dbId is not ingested, the checksums in " << checksumFile << " cannot be used for --verify." << endl;
+        }
+
+        f = fopen(checksumFile.c_str(), "w");
+        if (!f) {
+            cout << "ERROR: Cannot write checksums to file " << checksumFile << endl;
+            return;
+        }
+        fprintf(f, "# fileNum snapnum dbIdColumn minDbId maxDbId column type rows nonNull sum sumAbs xor\n");
+        for (map<int, vector<ColumnChecksum> >::iterator it = results.begin(); it != results.end(); it++) {
+            for (size_t i=0; i<it->second.size(); i++) {
+                ColumnChecksum &c = it->second[i];
+                if (c.rows == 0) {
+                    continue; // constant items are not passed through the reader
+                }
+                fprintf(f, "%d %d %s %ld %ld %s %s %ld %ld %.17g %.17g %016lx\n", fileNum, it->first,
+                        (dbIdIndex >= 0) ? columnNames[dbIdIndex].c_str() : "-",
+                        (dbIdIndex >= 0) ? minDbId[it->first] : -1L, (dbIdIndex >= 0) ? maxDbId[it->first] : -1L,
+                        c.column.c_str(), c.dtype.c_str(), c.rows, c.nonNull, c.sum, c.sumAbs, c.xorBits);
+            }
+        }
+        fclose(f);
+
+        printf("Checksums of %ld outputs written to %s\n", (long) results.size(), checksumFile.c_str());
+        fflush(stdout);
+    }
+
+
+    // checksums of one output, as read from a checksum file
+    class OutputChecksums {
+        public:
+            int fileNum;
+            int snapnum;
+            string dbIdColumn;
+            long minDbId;
+            long maxDbId;
+            vector<ColumnChecksum> columns;
+    };
+
+    static bool readChecksumFiles(vector<string> &checksumFiles, vector<OutputChecksums> &outputs) {
+        map<pair<int,int>, int> outputIndex;
+        pair<int,int> key;
+        string line;
+        OutputChecksums o;
+        ColumnChecksum c;
+        string xorStr;
+
+        for (size_t i=0; i<checksumFiles.size(); i++) {
+            ifstream in(checksumFiles[i].c_str());
+            if (!in) {
+                cout << "ERROR: Cannot open checksum file " << checksumFiles[i] << endl;
+                return false;
+            }
+            while (getline(in, line)) {
+                if (line.length() == 0 || line[0] == '#') {
+                    continue;
+                }
+                stringstream ss(line);
+                if (!(ss >> o.fileNum >> o.snapnum >> o.dbIdColumn >> o.minDbId >> o.maxDbId
+                         >> c.column >> c.dtype >> c.rows >> c.nonNull >> c.sum >> c.sumAbs >> xorStr)) {
+                    cout << "ERROR: Invalid line in checksum file " << checksumFiles[i] << ": " << line << endl;
+                    return false;
+                }
+                if (o.dbIdColumn == "-") {
+                    cout << "ERROR: Checksum file " << checksumFiles[i] << " has no dbId ranges (dbId was not ingested)." << endl;
+                    return false;
+                }
+                c.xorBits = strtoul(xorStr.c_str(), NULL, 16);
+
+                // files of several partitions of the same output are combined
+                key = make_pair(o.fileNum, o.snapnum);
+                if (outputIndex.find(key) == outputIndex.end()) {
+                    outputIndex[key] = outputs.size();
+                    outputs.push_back(o);
+                    outputs.back().columns.clear();
+                }
+                OutputChecksums &out = outputs[outputIndex[key]];
+                out.minDbId = (o.minDbId < out.minDbId) ? o.minDbId : out.minDbId;
+                out.maxDbId = (o.maxDbId > out.maxDbId) ? o.maxDbId : out.maxDbId;
+                size_t k = 0;
+                while (k < out.columns.size() && out.columns[k].column != c.column) {
+                    k++;
+                }
+                if (k == out.columns.size()) {
+                    out.columns.push_back(c);
+                } else {
+                    out.columns[k].rows += c.rows;
+                    out.columns[k].nonNull += c.nonNull;
+                    out.columns[k].sum += c.sum;
+                    out.columns[k].sumAbs += c.sumAbs;
+                    out.columns[k].xorBits ^= c.xorBits;
+                }
+            }
+        }
+        return true;
+    }
+
+#ifdef DB_MYSQL
+    static bool sumsMatch(const ColumnChecksum &c, double dbSum) {
+        // rounding differs with the order of summation (and for REAL4 columns)
+        return (fabs(c.sum - dbSum) <= 1e-6 * c.sumAbs + 1e-300);
+    }
+#endif
+
+    int verifyChecksums(vector<string> checksumFiles, const IngestSettings &settings) {
+        vector<OutputChecksums> outputs;
+
+        if (!readChecksumFiles(checksumFiles, outputs)) {
+            return EXIT_FAILURE;
+        }
+
+#ifdef DB_MYSQL
+        if (settings.system.compare("mysql") == 0) {
+            long numMismatches = 0;
+            MYSQL *conn = mysql_init(NULL);
+            MYSQL_RES *res;
+            MYSQL_ROW row;
+            string table = "`" + settings.table + "`";
+
+            if (settings.dbase != "") {
+                table = "`" + settings.dbase + "`." + table;
+            }
+            if (!mysql_real_connect(conn, settings.host.c_str(), settings.user.c_str(), settings.pwd.c_str(), NULL,
+                                    atoi(settings.port.c_str()), (settings.socket != "") ? settings.socket.c_str() : NULL, 0)) {
+                cout << "ERROR: Cannot connect to the database for verifying: " << mysql_error(conn) << endl;
+                mysql_close(conn);
+                return EXIT_FAILURE;
+            }
+
+            for (size_t i=0; i<outputs.size(); i++) {
+                OutputChecksums &o = outputs[i];
+                vector<string> problems;
+                stringstream query;
+
+                // one aggregate query per output, using the (primary key) dbId range
+                query << "SELECT COUNT(*)";
+                for (size_t k=0; k<o.columns.size(); k++) {
+                    query << ", COUNT(`" << o.columns[k].column << "`), SUM(`" << o.columns[k].column << "`), ";
+                    if (o.columns[k].dtype == "int") {
+                        query << "BIT_XOR(`" << o.columns[k].column << "`)";
+                    } else {
+                        query << "0";
+                    }
+                }
+                query << " FROM " << table << " WHERE `" << o.dbIdColumn << "` BETWEEN " << o.minDbId << " AND " << o.maxDbId;
+
+                if (mysql_query(conn, query.str().c_str()) != 0 || !(res = mysql_store_result(conn))) {
+                    cout << "ERROR: Query for fileNum " << o.fileNum << ", snapnum " << o.snapnum << " failed: " << mysql_error(conn) << endl;
+                    mysql_close(conn);
+                    return EXIT_FAILURE;
+                }
+                row = mysql_fetch_row(res);
+
+                long rows = atol(row[0]);
+                if (o.columns.size() > 0 && rows != o.columns[0].rows) {
+                    stringstream ss;
+                    ss << rows << " rows instead of " << o.columns[0].rows;
+                    problems.push_back(ss.str());
+                }
+                for (size_t k=0; k<o.columns.size(); k++) {
+                    ColumnChecksum &c = o.columns[k];
+                    long nonNull = atol(row[1 + 3*k]);
+                    double dbSum = row[2 + 3*k] ? atof(row[2 + 3*k]) : 0;
+                    unsigned long dbXor = row[3 + 3*k] ? strtoul(row[3 + 3*k], NULL, 10) : 0;
+
+                    if (nonNull != c.nonNull) {
+                        stringstream ss;
+                        ss << c.column << ": " << nonNull << " values instead of " << c.nonNull;
+                        problems.push_back(ss.str());
+                    } else if (c.dtype == "int" && dbXor != c.xorBits) {
+                        problems.push_back(c.column + ": XOR of the values differs");
+                    } else if (c.dtype != "int" && !sumsMatch(c, dbSum)) {
+                        stringstream ss;
+                        ss.precision(17);
+                        ss << c.column << ": sum " << dbSum << " instead of " << c.sum;
+                        problems.push_back(ss.str());
+                    }
+                }
+                mysql_free_result(res);
+
+                if (problems.size() == 0) {
+                    printf("Verify fileNum %d, snapnum %d: %ld rows OK\n", o.fileNum, o.snapnum, rows);
+                } else {
+                    printf("Verify fileNum %d, snapnum %d: MISMATCH\n", o.fileNum, o.snapnum);
+                    for (size_t p=0; p<problems.size(); p++) {
+                        printf("    %s\n", problems[p].c_str());
+                    }
+                    numMismatches++;
+                }
+            }
+            mysql_close(conn);
+
+            printf("Verified %ld outputs, %ld with mismatches\n", (long) outputs.size(), numMismatches);
+            fflush(stdout);
+            return (numMismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+#endif
+
+        cout << "ERROR: Verifying is only implemented for mysql (not for " << settings.system << ")." << endl;
+        return EXIT_FAILURE;
+    }
+
+}
@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <DataObjDesc.h>
+#include <Schema.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Galacticus_ItemIndex.h"
+
+#ifndef Galacticus_Galacticus_Checksums_h
+#define Galacticus_Galacticus_Checksums_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    class IngestSettings;
+
+    // order-independent checksum of the values of one column for one output
+    class ColumnChecksum {
+        public:
+            string column;      // name in the database table
+            string dtype;
+            long rows;
+            long nonNull;       // NaN and Inf count as NULL, as they cannot be stored
+            double sum;
+            double sumAbs;      // for the tolerance of floating point sums
+            unsigned long xorBits;  // XOR of the values (integer columns)
+
+            ColumnChecksum();
+            ColumnChecksum(string newColumn, string newDType);
+    };
+
+
+    // checksums of all ingested values per (fileNum, snapnum, column), i.e.
+    // of what was sent to the database, together with the dbId range of each
+    // output; written as text file, for verifying the table with --verify
+    class ChecksumCollector {
+        private:
+            string checksumFile;
+            int fileNum;
+
+            ItemIndex items;
+            vector<string> columnNames;
+            int dbIdIndex;          // -1, if dbId is not ingested
+
+            int current_snapnum;
+            vector<ColumnChecksum> *current;
+            map<int, vector<ColumnChecksum> > results;
+            map<int, long> minDbId;
+            map<int, long> maxDbId;
+            bool written;
+
+        public:
+            ChecksumCollector();
+            ChecksumCollector(string newChecksumFile, int newFileNum, DBDataSchema::Schema *schema);
+            ~ChecksumCollector();
+
+            void addValue(DBDataSchema::DataObjDesc *item, int snapnum, bool isNull, void *value);
+            void write();
+    };
+
+    // compare checksum files with aggregate queries on the table (-D, -T);
+    // returns EXIT_SUCCESS, if everything matches
+    int verifyChecksums(vector<string> checksumFiles, const IngestSettings &settings);
+
+}
+
+#endif
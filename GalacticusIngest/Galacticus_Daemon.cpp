@@ -0,0 +1,552 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <boost/bind.hpp>
+
+#include "Galacticus_Daemon.h"
+
+namespace Galacticus {
+
+    IngestSettings::IngestSettings() {
+        bufferSize = 128;
+        outputFreq = 100000;
+        resumeMode = false;
+        isDryRun = false;
+        hubble_h = 0.7;
+        ioProfile = "default";
+        ioCacheSize = 256;
+    }
+
+    void applyConnectionSettings(DBIngest::DBIngestor *ingestor, const IngestSettings &settings) {
+        ingestor->setUsrName(settings.user);
+        ingestor->setPasswd(settings.pwd);
+
+        //settings for different DBs (copy&paste from AsciiIngest)
+        if (settings.system.compare("mysql") == 0) {
+            ingestor->setSocket(settings.socket);
+            ingestor->setPort(settings.port);
+            ingestor->setHost(settings.host);
+        } else if (settings.system.compare("sqlite3") == 0) {
+            ingestor->setHost(settings.path);
+        } else if (settings.system.compare("unix_sqlsrv_odbc") == 0) {
+            ingestor->setSocket("DRIVER=FreeTDS;TDS_Version=7.0;");
+            //ingestor->setSocket("DRIVER=SQL Server Native Client 10.0;");
+            ingestor->setPort(settings.port);
+            ingestor->setHost(settings.host);
+        } else if (settings.system.compare("sqlsrv_odbc") == 0) {
+            ingestor->setSocket("DRIVER=SQL Server Native Client 10.0;");
+            ingestor->setPort(settings.port);
+            ingestor->setHost(settings.host);
+        } else if (settings.system.compare("sqlsrv_odbc_bulk") == 0) {
+            //TESTS ON SQL SERVER SHOWED THIS IS VERY SLOW. BUT NO CLUE WHY, DID NOT BOTHER TO LOOK AT PROFILER YET
+            ingestor->setSocket("DRIVER=SQL Server Native Client 10.0;");
+            ingestor->setPort(settings.port);
+            ingestor->setHost(settings.host);
+        }  else if (settings.system.compare("cust_odbc") == 0) {
+            ingestor->setSocket(settings.socket);
+            ingestor->setPort(settings.port);
+            ingestor->setHost(settings.host);
+        } else if (settings.system.compare("cust_odbc_bulk") == 0) {
+            //TESTS ON SQL SERVER SHOWED THIS IS VERY SLOW. BUT NO CLUE WHY, DID NOT BOTHER TO LOOK AT PROFILER YET
+            ingestor->setSocket(settings.socket);
+            ingestor->setPort(settings.port);
+            ingestor->setHost(settings.host);
+        }
+    }
+
+
+    IngestJob::IngestJob() {
+        id = 0;
+        fileNum = 0;
+        state = "queued";
+        rows = 0;
+        reader = NULL;
+    }
+
+
+    // split a command line into words; double quotes group words,
+    // e.g. where="diskMassStellar > 1e9"
+    static vector<string> splitCommand(const string line) {
+        vector<string> tokens;
+        string token;
+        bool quoted = false;
+        bool inToken = false;
+
+        for (string::size_type i=0; i<line.length(); i++) {
+            char c = line[i];
+            if (c == '"') {
+                quoted = !quoted;
+                inToken = true;
+            } else if (!quoted && (c == ' ' || c == '\t' || c == '\r' || c == '\n')) {
+                if (inToken) {
+                    tokens.push_back(token);
+                    token = "";
+                    inToken = false;
+                }
+            } else {
+                token += c;
+                inToken = true;
+            }
+        }
+        if (inToken) {
+            tokens.push_back(token);
+        }
+        return tokens;
+    }
+
+    static vector<string> splitList(const string value) {
+        vector<string> items;
+        stringstream ss(value);
+        string item;
+        while (getline(ss, item, ',')) {
+            if (item != "") {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    static double getSeconds(boost::posix_time::ptime start, boost::posix_time::ptime end) {
+        return (end - start).total_milliseconds() / 1000.;
+    }
+
+
+    IngestDaemon::IngestDaemon(string newSocketPath, int newNumWorkers, IngestSettings newDefaults) {
+        socketPath = newSocketPath;
+        numWorkers = newNumWorkers;
+        if (numWorkers < 1) {
+            numWorkers = 1;
+        }
+        defaults = newDefaults;
+        numRunning = 0;
+        stopping = false;
+    }
+
+    IngestDaemon::~IngestDaemon() {
+        for (size_t i=0; i<jobs.size(); i++) {
+            delete jobs[i];
+        }
+    }
+
+    int IngestDaemon::run() {
+        // accept one command per connection, until shutdown
+        struct sockaddr_un addr;
+        int fd;
+        int client;
+        char buf[4096];
+        ssize_t n;
+
+        if (socketPath.length() >= sizeof(addr.sun_path)) {
+            cout << "ERROR: Socket path " << socketPath << " is too long." << endl;
+            return EXIT_FAILURE;
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            perror("ERROR: Cannot create socket");
+            return EXIT_FAILURE;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        unlink(socketPath.c_str()); // left over from a previous daemon
+        if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+            perror("ERROR: Cannot listen on socket");
+            close(fd);
+            return EXIT_FAILURE;
+        }
+
+        startTime = boost::posix_time::microsec_clock::universal_time();
+        boost::thread_group workers;
+        for (int w=0; w<numWorkers; w++) {
+            workers.create_thread(boost::bind(&IngestDaemon::worker, this));
+        }
+        cout << "Ingest daemon listening on " << socketPath << " with " << numWorkers << " workers" << endl;
+
+        while (true) {
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                if (stopping) {
+                    break;
+                }
+            }
+
+            client = accept(fd, NULL, NULL);
+            if (client < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("ERROR: accept failed");
+                break;
+            }
+
+            // read one line
+            string line;
+            while (line.find('\n') == string::npos && (n = recv(client, buf, sizeof(buf), 0)) > 0) {
+                line.append(buf, n);
+            }
+            line = line.substr(0, line.find('\n'));
+
+            string reply = handleCommand(line);
+            const char *p = reply.c_str();
+            size_t left = reply.length();
+            while (left > 0 && (n = send(client, p, left, MSG_NOSIGNAL)) > 0) {
+                p += n;
+                left -= n;
+            }
+            close(client);
+        }
+
+        close(fd);
+        unlink(socketPath.c_str());
+
+        // the workers finish all queued jobs first
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        workers.join_all();
+        cout << "Ingest daemon stopped." << endl;
+
+        return EXIT_SUCCESS;
+    }
+
+    string IngestDaemon::handleCommand(const string line) {
+        vector<string> tokens = splitCommand(line);
+
+        if (tokens.size() == 0) {
+            return "ERROR: empty command\n";
+        }
+        if (tokens[0] == "ingest") {
+            return addJob(tokens);
+        }
+        if (tokens[0] == "status") {
+            return getStatus(tokens);
+        }
+        if (tokens[0] == "shutdown") {
+            boost::mutex::scoped_lock lock(mutex);
+            stopping = true;
+            return "shutting down after the queued jobs\n";
+        }
+        return "ERROR: unknown command " + tokens[0] + "\n";
+    }
+
+    string IngestDaemon::addJob(const vector<string> &tokens) {
+        IngestJob *job = new IngestJob();
+        string key;
+        string value;
+        string::size_type pos;
+
+        job->settings = defaults;
+        for (size_t i=1; i<tokens.size(); i++) {
+            pos = tokens[i].find('=');
+            if (pos == string::npos) {
+                delete job;
+                return "ERROR: expected key=value instead of " + tokens[i] + "\n";
+            }
+            key = tokens[i].substr(0, pos);
+            value = tokens[i].substr(pos + 1);
+
+            if (key == "data") {
+                vector<string> files = splitList(value);
+                job->dataFiles.insert(job->dataFiles.end(), files.begin(), files.end());
+            } else if (key == "fileNum") {
+                job->fileNum = atoi(value.c_str());
+            } else if (key == "snapnums") {
+                vector<string> snapnums = splitList(value);
+                for (size_t j=0; j<snapnums.size(); j++) {
+                    job->snapnums.push_back(atoi(snapnums[j].c_str()));
+                }
+            } else if (key == "table") {
+                job->settings.table = value;
+            } else if (key == "dbase") {
+                job->settings.dbase = value;
+            } else if (key == "fieldmap") {
+                job->settings.mapFile = value;
+            } else if (key == "where") {
+                job->whereExpr = value;
+            } else if (key == "bufferSize") {
+                job->settings.bufferSize = atoi(value.c_str());
+            } else {
+                delete job;
+                return "ERROR: unknown job parameter " + key + "\n";
+            }
+        }
+        if (job->dataFiles.size() == 0) {
+            delete job;
+            return "ERROR: no data file given\n";
+        }
+
+        stringstream ss;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if (stopping) {
+                delete job;
+                return "ERROR: daemon is shutting down\n";
+            }
+            job->id = jobs.size() + 1;
+            jobs.push_back(job);
+            queue.push_back(job);
+            ss << "queued job " << job->id << endl;
+        }
+        jobAvailable.notify_one();
+
+        return ss.str();
+    }
+
+    long IngestDaemon::getJobRows(IngestJob *job) {
+        // approximate while running (the reader's counter is read without lock)
+        if (job->reader) {
+            return job->reader->getCurrRow();
+        }
+        return job->rows;
+    }
+
+    string IngestDaemon::getJobStatus(IngestJob *job) {
+        stringstream ss;
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        double seconds = 0;
+        long rows = getJobRows(job);
+
+        if (job->state == "running") {
+            seconds = getSeconds(job->startTime, now);
+        } else if (job->state != "queued") {
+            seconds = getSeconds(job->startTime, job->endTime);
+        }
+
+        ss << "job " << job->id << " " << job->state << " rows=" << rows << " seconds=" << seconds;
+        if (seconds > 0) {
+            ss << " rate=" << (long) (rows / seconds);
+        }
+        ss << " fileNum=" << job->fileNum << " table=" << job->settings.table << " data=";
+        for (size_t f=0; f<job->dataFiles.size(); f++) {
+            ss << (f > 0 ? "," : "") << job->dataFiles[f];
+        }
+        if (job->message != "") {
+            ss << " message=\"" << job->message << "\"";
+        }
+        ss << endl;
+        return ss.str();
+    }
+
+    string IngestDaemon::getStatus(const vector<string> &tokens) {
+        // summary and one line per job (or only the given job)
+        boost::mutex::scoped_lock lock(mutex);
+        stringstream ss;
+        long numQueued = 0;
+        long numDone = 0;
+        long numFailed = 0;
+        long totalRows = 0;
+        double seconds = getSeconds(startTime, boost::posix_time::microsec_clock::universal_time());
+
+        if (tokens.size() > 1) {
+            int id = atoi(tokens[1].c_str());
+            if (id < 1 || id > (int) jobs.size()) {
+                return "ERROR: no job " + tokens[1] + "\n";
+            }
+            return getJobStatus(jobs[id-1]);
+        }
+
+        for (size_t i=0; i<jobs.size(); i++) {
+            if (jobs[i]->state == "queued") {
+                numQueued++;
+            } else if (jobs[i]->state == "done") {
+                numDone++;
+            } else if (jobs[i]->state == "failed") {
+                numFailed++;
+            }
+            totalRows += getJobRows(jobs[i]);
+        }
+
+        ss << "workers=" << numWorkers << " queued=" << numQueued << " running=" << numRunning
+           << " done=" << numDone << " failed=" << numFailed << " rows=" << totalRows
+           << " seconds=" << seconds << " rate=" << (long) (seconds > 0 ? totalRows / seconds : 0) << endl;
+        for (size_t i=0; i<jobs.size(); i++) {
+            ss << getJobStatus(jobs[i]);
+        }
+        return ss.str();
+    }
+
+    void IngestDaemon::worker() {
+        IngestWorker ingestWorker(defaults.system, &mutex);
+        IngestJob *job;
+
+        while (true) {
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                while (queue.size() == 0 && !stopping) {
+                    jobAvailable.wait(lock);
+                }
+                if (queue.size() == 0) {
+                    break;
+                }
+                job = queue.front();
+                queue.pop_front();
+                numRunning++;
+            }
+
+            ingestWorker.runJob(job);
+
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                numRunning--;
+                cout << getJobStatus(job);
+            }
+        }
+    }
+
+
+    IngestWorker::IngestWorker(string system, boost::mutex *newStatusMutex) {
+        statusMutex = newStatusMutex;
+        dbServer = adaptorFac.getDBAdaptors(system);
+        assertFac = new DBAsserter::AsserterFactory;
+        convFac = new DBConverter::ConverterFactory;
+    }
+
+    IngestWorker::~IngestWorker() {
+        for (map<string, CachedSchema>::iterator it = schemas.begin(); it != schemas.end(); it++) {
+            delete it->second.schema;
+            delete it->second.mapper;
+        }
+        delete dbServer;
+        //delete assertFac;
+        //delete convFac;
+    }
+
+    void IngestWorker::runJob(IngestJob *job) {
+        // errors in the data or the database are reported as failed job; note
+        // that fatal errors (abort/exit in reader or ingestor) stop the process
+        GalacticusReader *reader = NULL;
+        IngestSettings &settings = job->settings;
+        string state = "done";
+        string message = "";
+
+        {
+            boost::mutex::scoped_lock lock(*statusMutex);
+            job->state = "running";
+            job->startTime = boost::posix_time::microsec_clock::universal_time();
+        }
+
+        try {
+            reader = new GalacticusReader(job->dataFiles, job->fileNum, job->snapnums, settings.hubble_h);
+            if (settings.ioProfile != "default") {
+                reader->setIOProfile(settings.ioProfile, settings.ioCacheSize * 1048576);
+            }
+            if (job->whereExpr != "") {
+                reader->setFilter(job->whereExpr);
+            }
+
+            string key = settings.mapFile + string("\n") + settings.dbase + string("\n") + settings.table;
+            map<string, CachedSchema>::iterator it = schemas.find(key);
+            if (it == schemas.end()) {
+                CachedSchema c;
+                c.mapper = new GalacticusSchemaMapper(assertFac, convFac);
+                c.mapper->readMappingFile(settings.mapFile);
+                c.schema = c.mapper->generateSchema(settings.dbase, settings.table);
+                it = schemas.insert(make_pair(key, c)).first;
+            }
+            vector<pair<string, string> > assertions = it->second.mapper->getAssertions();
+            for (size_t i=0; i<assertions.size(); i++) {
+                reader->addAssertion(assertions[i].first, assertions[i].second);
+            }
+
+            DBIngest::DBIngestor ingestor(it->second.schema, reader, dbServer);
+            applyConnectionSettings(&ingestor, settings);
+            ingestor.setResumeMode(settings.resumeMode);
+            ingestor.setIsDryRun(settings.isDryRun);
+            ingestor.setAskUserToValidateRead(false);
+            ingestor.setPerformanceMeter(settings.outputFreq);
+
+            {
+                boost::mutex::scoped_lock lock(*statusMutex);
+                job->reader = reader;
+            }
+            ingestor.ingestData(settings.bufferSize);
+            if (reader->getNumFailedOutputs() > 0) {
+                stringstream ss;
+                ss << "assertions failed for " << reader->getNumFailedOutputs() << " outputs";
+                state = "failed";
+                message = ss.str();
+            }
+        } catch (H5::Exception &e) {
+            state = "failed";
+            message = e.getDetailMsg();
+        } catch (std::exception &e) {
+            state = "failed";
+            message = e.what();
+        } catch (...) {
+            state = "failed";
+            message = "unknown error";
+        }
+
+        boost::mutex::scoped_lock lock(*statusMutex);
+        if (reader) {
+            job->rows = reader->getCurrRow();
+        }
+        job->reader = NULL;
+        job->state = state;
+        job->message = message;
+        job->endTime = boost::posix_time::microsec_clock::universal_time();
+        delete reader;
+    }
+
+
+    int sendDaemonCommand(string socketPath, string command) {
+        struct sockaddr_un addr;
+        int fd;
+        char buf[4096];
+        ssize_t n;
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+            perror("ERROR: Cannot connect to ingest daemon");
+            return EXIT_FAILURE;
+        }
+
+        command += "\n";
+        if (send(fd, command.c_str(), command.length(), MSG_NOSIGNAL) != (ssize_t) command.length()) {
+            perror("ERROR: Cannot send command to ingest daemon");
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        shutdown(fd, SHUT_WR);
+
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            fwrite(buf, 1, n, stdout);
+        }
+        close(fd);
+
+        return EXIT_SUCCESS;
+    }
+
+}
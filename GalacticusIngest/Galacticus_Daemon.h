@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <DBIngestor.h>
+#include <DBAdaptorsFactory.h>
+#include <AsserterFactory.h>
+#include <ConverterFactory.h>
+#include <Schema.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Galacticus_Reader.h"
+#include "Galacticus_SchemaMapper.h"
+
+#ifndef Galacticus_Galacticus_Daemon_h
+#define Galacticus_Galacticus_Daemon_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // database connection and ingest parameters
+    class IngestSettings {
+        public:
+            string system;
+            string dbase;
+            string table;
+            string mapFile;
+            string user;
+            string pwd;
+            string port;
+            string host;
+            string socket;
+            string path;
+            uint32_t bufferSize;
+            uint32_t outputFreq;
+            bool resumeMode;
+            bool isDryRun;
+            float hubble_h;
+            string ioProfile;
+            long ioCacheSize;   // in MB
+
+            IngestSettings();
+    };
+
+    // pass the connection parameters to the ingestor, depending on the database system
+    void applyConnectionSettings(DBIngest::DBIngestor *ingestor, const IngestSettings &settings);
+
+
+    // one ingest job of the daemon
+    class IngestJob {
+        public:
+            int id;
+            vector<string> dataFiles;
+            int fileNum;
+            vector<int> snapnums;
+            string whereExpr;
+            IngestSettings settings;
+
+            string state;   // queued, running, done, failed
+            string message;
+            long rows;
+            GalacticusReader *reader;   // while running, for the current number of rows
+            boost::posix_time::ptime startTime;
+            boost::posix_time::ptime endTime;
+
+            IngestJob();
+    };
+
+
+    // parsed field map and schema, kept by each worker for further jobs
+    class CachedSchema {
+        public:
+            GalacticusSchemaMapper *mapper;
+            DBDataSchema::Schema *schema;
+    };
+
+
+    // Runs ingest jobs one after the other and keeps the database adaptor
+    // and the schemas of all field maps used so far. The job's state and
+    // reader are updated under the given mutex, for status requests.
+    class IngestWorker {
+        private:
+            boost::mutex *statusMutex;
+            DBServer::DBAdaptorsFactory adaptorFac;
+            DBServer::DBAbstractor *dbServer;
+            DBAsserter::AsserterFactory *assertFac;
+            DBConverter::ConverterFactory *convFac;
+            map<string, CachedSchema> schemas;
+
+        public:
+            IngestWorker(string system, boost::mutex *newStatusMutex);
+            ~IngestWorker();
+
+            void runJob(IngestJob *job);
+    };
+
+
+    // Long-running ingest server: jobs are submitted as text lines through
+    // a local Unix socket and run by a fixed number of worker threads, so a
+    // job only needs to open its data file(s). Commands:
+    //   ingest data=<file>[,<file>...] [fileNum=<n>] [snapnums=<n>,<n>...]
+    //          [table=<t>] [dbase=<d>] [fieldmap=<f>] [where="<expr>"] [bufferSize=<n>]
+    //   status [<job id>]
+    //   shutdown
+    class IngestDaemon {
+        private:
+            string socketPath;
+            int numWorkers;
+            IngestSettings defaults;
+
+            boost::mutex mutex;
+            boost::condition_variable jobAvailable;
+            deque<IngestJob*> queue;
+            vector<IngestJob*> jobs;
+            int numRunning;
+            bool stopping;
+            boost::posix_time::ptime startTime;
+
+            void worker();
+            string handleCommand(const string line);
+            string addJob(const vector<string> &tokens);
+            string getStatus(const vector<string> &tokens);
+            string getJobStatus(IngestJob *job);
+            long getJobRows(IngestJob *job);
+
+        public:
+            IngestDaemon(string newSocketPath, int newNumWorkers, IngestSettings newDefaults);
+            ~IngestDaemon();
+
+            int run();
+    };
+
+    // send one command to a running daemon and print its answer
+    int sendDaemonCommand(string socketPath, string command);
+
+}
+
+#endif
@@ -0,0 +1,352 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Galacticus_FanOut.h"
+#include "galacticusingest_error.h"
+
+// size of one value slot in a batch, large enough for all numeric types
+#define FANOUT_SLOTSIZE 8
+
+namespace Galacticus {
+
+    // runs the DBIngestor of one target in its own thread
+    class FanOutTask {
+        private:
+            FanOut *fanOut;
+            int target;
+            DBIngest::DBIngestor *ingestor;
+            uint32_t bufferSize;
+
+        public:
+            FanOutTask(FanOut *newFanOut, int newTarget, DBIngest::DBIngestor *newIngestor, uint32_t newBufferSize) {
+                fanOut = newFanOut;
+                target = newTarget;
+                ingestor = newIngestor;
+                bufferSize = newBufferSize;
+            }
+
+            void operator()() {
+                try {
+                    ingestor->ingestData(bufferSize);
+                    fanOut->detach(target, "");
+                } catch (std::exception &e) {
+                    fanOut->detach(target, e.what());
+                } catch (...) {
+                    fanOut->detach(target, "unknown error");
+                }
+            }
+    };
+
+
+    FanOutReader::FanOutReader() {
+        fanOut = NULL;
+        current = NULL;
+    }
+
+    FanOutReader::FanOutReader(FanOut *newFanOut, string name, DBDataSchema::Schema *schema) {
+        fanOut = newFanOut;
+        target = fanOut->addTarget(name, schema, slots);
+
+        for (size_t i=0; i<schema->getArrSchemaItems().size(); i++) {
+            DBDataSchema::DataObjDesc *item = schema->getArrSchemaItems().at(i)->getDataDesc();
+            items.add(item);
+        }
+
+        current = NULL;
+        currentBatch = -1;
+        currentRow = 0;
+        finished = false;
+
+        routeMask = 0;
+        unrouted = false;
+    }
+
+    void FanOutReader::setRoute(unsigned long newRouteMask, bool newUnrouted) {
+        routeMask = newRouteMask;
+        unrouted = newUnrouted;
+    }
+
+    bool FanOutReader::isRouted(long row) {
+        // should this target get the given row of the current batch?
+        if (routeMask == 0 && !unrouted) {
+            return true;
+        }
+        unsigned long mask = fanOut->getRouteMasks(currentBatch)[row];
+        if (unrouted) {
+            return (mask == 0);
+        }
+        return ((mask & routeMask) != 0);
+    }
+
+    FanOutReader::~FanOutReader() {
+    }
+
+    int FanOutReader::getIndex(DBDataSchema::DataObjDesc *item) {
+        int i = items.find(item);
+        if (i < 0) {
+            cout << "ERROR: Item " << item->getDataObjName() << " is not part of the schema of this target." << endl;
+            abort();
+        }
+        return i;
+    }
+
+    int FanOutReader::getNextRow() {
+        if (finished) {
+            return 0;
+        }
+
+        while (true) {
+            if (current) {
+                currentRow++;
+                while (currentRow < current->nrows) {
+                    if (isRouted(currentRow)) {
+                        return 1;
+                    }
+                    currentRow++;
+                }
+                fanOut->releaseBatch(target, currentBatch);
+                current = NULL;
+            }
+
+            currentBatch++;
+            current = fanOut->getBatch(target, currentBatch);
+            if (!current) {
+                finished = true;
+                return 0;
+            }
+            currentRow = -1;
+        }
+    }
+
+    bool FanOutReader::getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result) {
+        int i = getIndex(thisItem);
+        if (slots[i] < 0) {
+            getConstItem(thisItem, result);
+            return false;
+        }
+        long k = currentRow * current->nitems + slots[i];
+
+        memcpy(result, &current->values[k * FANOUT_SLOTSIZE], DBDataSchema::getByteLenOfDType(thisItem->getDataObjDType()));
+        return current->nulls[k];
+    }
+
+    void FanOutReader::getConstItem(DBDataSchema::DataObjDesc * thisItem, void* result) {
+        // only copies the value from the item, safe while the source reads on
+        fanOut->getSource()->getConstItem(thisItem, result);
+    }
+
+    void FanOutReader::openFile(string newFileName) {
+        // the files belong to the source, which is shared by all targets
+    }
+
+    void FanOutReader::closeFile() {
+    }
+
+
+    FanOut::FanOut(GalacticusReader *newSource, int newNumQueueBatches, long newBatchRows) {
+        source = newSource;
+        numQueueBatches = (newNumQueueBatches < 2) ? 2 : newNumQueueBatches;
+        batchRows = (newBatchRows < 1) ? 1 : newBatchRows;
+        numActive = 0;
+        numProduced = 0;
+        producerDone = false;
+    }
+
+    int FanOut::addTarget(string name, DBDataSchema::Schema *schema, vector<int> &itemSlots) {
+        // items with the same name and type are read only once for all targets;
+        // constant items are not shared, their values may differ per field map
+        itemSlots.clear();
+        for (size_t i=0; i<schema->getArrSchemaItems().size(); i++) {
+            DBDataSchema::DataObjDesc *item = schema->getArrSchemaItems().at(i)->getDataDesc();
+            if (item->getIsConstItem()) {
+                itemSlots.push_back(-1);
+                continue;
+            }
+            if (DBDataSchema::getByteLenOfDType(item->getDataObjDType()) > FANOUT_SLOTSIZE) {
+                cout << "ERROR: Column " << schema->getArrSchemaItems().at(i)->getColumnName()
+                     << " has a data type that is not supported with several targets." << endl;
+                abort();
+            }
+
+            stringstream key;
+            key << item->getDataObjName() << "/" << item->getDataObjDType();
+            map<string, int>::iterator it = slotIndex.find(key.str());
+            if (it == slotIndex.end()) {
+                it = slotIndex.insert(make_pair(key.str(), (int) items.size())).first;
+                items.push_back(item);
+            }
+            itemSlots.push_back(it->second);
+        }
+
+        targetNames.push_back(name);
+        targetErrors.push_back("");
+        nextBatch.push_back(0);
+        active.push_back(true);
+        numActive++;
+        return targetNames.size() - 1;
+    }
+
+    int FanOut::getNumSlots() {
+        return items.size();
+    }
+
+    GalacticusReader *FanOut::getSource() {
+        return source;
+    }
+
+    int FanOut::run(vector<DBIngest::DBIngestor*> &ingestors, uint32_t bufferSize) {
+        boost::thread_group threads;
+        boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+        boost::posix_time::ptime endTime;
+        int numFailed = 0;
+
+        batches.resize(numQueueBatches);
+        pending.assign(numQueueBatches, 0);
+        batchRoutes.resize(numQueueBatches);
+        for (int i=0; i<numQueueBatches; i++) {
+            batches[i].allocate(batchRows, items.size());
+            if (source->getNumRoutes() > 0) {
+                batchRoutes[i].resize(batchRows);
+            }
+        }
+
+        for (size_t t=0; t<ingestors.size(); t++) {
+            threads.create_thread(FanOutTask(this, t, ingestors[t], bufferSize));
+        }
+        produce();
+        threads.join_all();
+
+        endTime = boost::posix_time::microsec_clock::universal_time();
+        printf("Fan-out: %ld batches read once for %ld tables, %d shared items: %lld ms\n",
+               numProduced, (long) targetNames.size(), (int) items.size(), (long long int) (endTime-startTime).total_milliseconds());
+        for (size_t t=0; t<targetNames.size(); t++) {
+            if (targetErrors[t] != "") {
+                printf("ERROR: Ingest into %s failed: %s\n", targetNames[t].c_str(), targetErrors[t].c_str());
+                numFailed++;
+            }
+        }
+        fflush(stdout);
+        return numFailed;
+    }
+
+    void FanOut::produce() {
+        // read complete rows into the next free batch of the ring
+        RowBatch *b;
+        char *values;
+        bool endOfData = false;
+        string error = "";
+
+        try {
+            while (!endOfData) {
+                {
+                    boost::mutex::scoped_lock lock(mutex);
+                    while (pending[numProduced % numQueueBatches] > 0 && numActive > 0) {
+                        changed.wait(lock);
+                    }
+                    if (numActive == 0) {
+                        break; // all targets failed, nobody needs the rows
+                    }
+                }
+
+                b = &batches[numProduced % numQueueBatches];
+                b->nrows = 0;
+                while (b->nrows < b->capacity) {
+                    if (!source->getNextRow()) {
+                        endOfData = true;
+                        break;
+                    }
+                    values = &b->values[b->nrows * b->nitems * FANOUT_SLOTSIZE];
+                    for (int i=0; i<b->nitems; i++) {
+                        b->nulls[b->nrows * b->nitems + i] = source->getItemInRow(items[i], true, true, values + i*FANOUT_SLOTSIZE);
+                    }
+                    if (batchRoutes[numProduced % numQueueBatches].size() > 0) {
+                        batchRoutes[numProduced % numQueueBatches][b->nrows] = source->getRouteMask();
+                    }
+                    b->nrows++;
+                }
+
+                boost::mutex::scoped_lock lock(mutex);
+                pending[numProduced % numQueueBatches] = numActive;
+                numProduced++;
+                changed.notify_all();
+            }
+        } catch (std::exception &e) {
+            error = e.what();
+        } catch (H5::Exception &e) {
+            error = e.getDetailMsg();
+        }
+        if (error != "") {
+            // the rows inserted so far are incomplete, so stop everything
+            string msg = string("Reading rows failed with several targets: ") + error;
+            GalacticusIngest_error(msg.c_str());
+        }
+
+        boost::mutex::scoped_lock lock(mutex);
+        producerDone = true;
+        changed.notify_all();
+    }
+
+    RowBatch *FanOut::getBatch(int target, long seq) {
+        // wait for the batch with the given sequence number, NULL at the end
+        boost::mutex::scoped_lock lock(mutex);
+        while (seq >= numProduced && !producerDone) {
+            changed.wait(lock);
+        }
+        if (seq >= numProduced) {
+            return NULL;
+        }
+        nextBatch[target] = seq;
+        return &batches[seq % numQueueBatches];
+    }
+
+    const unsigned long *FanOut::getRouteMasks(long seq) {
+        // only valid while the target uses the batch
+        return &batchRoutes[seq % numQueueBatches][0];
+    }
+
+    void FanOut::releaseBatch(int target, long seq) {
+        boost::mutex::scoped_lock lock(mutex);
+        pending[seq % numQueueBatches]--;
+        nextBatch[target] = seq + 1;
+        changed.notify_all();
+    }
+
+    void FanOut::detach(int target, string error) {
+        // the target does not need any more rows (finished or failed),
+        // so it must not hold back the remaining batches
+        boost::mutex::scoped_lock lock(mutex);
+        if (!active[target]) {
+            return;
+        }
+        for (long seq=nextBatch[target]; seq<numProduced; seq++) {
+            pending[seq % numQueueBatches]--;
+        }
+        active[target] = false;
+        numActive--;
+        targetErrors[target] = error;
+        changed.notify_all();
+    }
+
+}
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <Reader.h>
+#include <Schema.h>
+#include <DBIngestor.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/thread.hpp>
+
+#include "Galacticus_Reader.h"
+#include "Galacticus_Pipeline.h"
+
+#ifndef Galacticus_Galacticus_FanOut_h
+#define Galacticus_Galacticus_FanOut_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    class FanOut;
+
+    // Reader for one target table of a fan-out ingest: returns the rows of
+    // the shared batches, but only the items of its own schema
+    class FanOutReader : public DBReader::Reader {
+        private:
+            FanOut *fanOut;
+            int target;
+            ItemIndex items;
+            vector<int> slots;      // slot in the shared rows for each item (-1 = constant)
+
+            // horizontal partitioning: only rows of the given routes, or
+            // only rows without any route (for the default table)
+            unsigned long routeMask;
+            bool unrouted;
+
+            RowBatch *current;
+            long currentBatch;      // sequence number of the current batch
+            long currentRow;
+            bool finished;
+
+            int getIndex(DBDataSchema::DataObjDesc *item);
+            bool isRouted(long row);
+
+        public:
+            FanOutReader();
+            FanOutReader(FanOut *newFanOut, string name, DBDataSchema::Schema *schema);
+            ~FanOutReader();
+
+            void setRoute(unsigned long newRouteMask, bool newUnrouted);
+
+            void openFile(string newFileName);
+            void closeFile();
+            int getNextRow();
+            bool getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result);
+            void getConstItem(DBDataSchema::DataObjDesc * thisItem, void* result);
+    };
+
+
+    // Vertical partitioning: the rows are read and converted only once by
+    // the GalacticusReader and then inserted into several tables (each with
+    // its own field map, database connection and DBIngestor running in its
+    // own thread). Items with the same name and type are shared by all
+    // schemas. The batches form a ring; a batch is filled again only after
+    // all targets have inserted its rows, so the slowest table sets the pace.
+    // For horizontal partitioning, the route mask of each row is stored as
+    // well, so that each target can pick its rows.
+    class FanOut {
+        private:
+            GalacticusReader *source;
+            vector<DBDataSchema::DataObjDesc*> items;   // one per slot
+            map<string, int> slotIndex;                 // name and type -> slot
+
+            vector<RowBatch> batches;
+            vector<vector<unsigned long> > batchRoutes;  // route mask per batch and row
+            vector<int> pending;        // number of targets still using each batch
+            vector<long> nextBatch;     // next batch of each target
+            vector<bool> active;
+            int numActive;
+            long numProduced;
+            bool producerDone;
+            int numQueueBatches;
+            long batchRows;
+
+            boost::mutex mutex;
+            boost::condition_variable changed;
+
+            // for the error report of failed targets
+            vector<string> targetNames;
+            vector<string> targetErrors;
+
+        public:
+            FanOut(GalacticusReader *newSource, int newNumQueueBatches, long newBatchRows);
+
+            // register a target and its schema, returns the target number
+            int addTarget(string name, DBDataSchema::Schema *schema, vector<int> &itemSlots);
+            int getNumSlots();
+            GalacticusReader *getSource();
+
+            // read all rows and run the ingestors (one per target) until all
+            // rows are inserted everywhere; returns the number of failed targets
+            int run(vector<DBIngest::DBIngestor*> &ingestors, uint32_t bufferSize);
+            void produce();
+
+            // used by the target readers
+            RowBatch *getBatch(int target, long seq);
+            const unsigned long *getRouteMasks(long seq);
+            void releaseBatch(int target, long seq);
+            void detach(int target, string error);
+    };
+
+}
+
+#endif
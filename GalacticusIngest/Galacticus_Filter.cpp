@@ -0,0 +1,492 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include "galacticusingest_error.h"
+
+#include "Galacticus_Filter.h"
+
+// number of rows evaluated at once, small enough to keep
+// all intermediate buffers of an expression in cache
+#define FILTER_BLOCKSIZE 1024
+
+enum { FN_NUMBER, FN_COLUMN, FN_CONSTANT, FN_UNARY, FN_BINARY, FN_FUNCTION };
+enum { TK_END, TK_NUMBER, TK_IDENT, TK_OP };
+enum { OP_NEG, OP_NOT, OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+       OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE, OP_AND, OP_OR,
+       OP_LOG10, OP_ABS, OP_SQRT };
+
+namespace Galacticus {
+
+    FilterNode::FilterNode() {
+        type = FN_NUMBER;
+        op = 0;
+        value = 0;
+        name = "";
+        icolumn = -1;
+        left = NULL;
+        right = NULL;
+        tmp = NULL;
+    }
+
+    FilterNode::~FilterNode() {
+        delete left;
+        delete right;
+        delete[] tmp;
+    }
+
+
+    RowFilter::RowFilter() {
+        root = NULL;
+        candidateRows = NULL;
+        expression = "";
+    }
+
+    RowFilter::RowFilter(string newExpression) {
+        root = NULL;
+        candidateRows = NULL;
+        parse(newExpression);
+    }
+
+    RowFilter::~RowFilter() {
+        delete root;
+    }
+
+    string RowFilter::getExpression() {
+        return expression;
+    }
+
+    void RowFilter::setConstant(string name, double value) {
+        // constants must be known before parsing, otherwise they
+        // are taken for column names
+        constants[name] = value;
+    }
+
+    vector<string> RowFilter::getColumnNames() {
+        return columnNames;
+    }
+
+    void RowFilter::bindColumn(int icolumn, double *doubleval, long *longval, long first) {
+        columnDoubles[icolumn] = doubleval;
+        columnLongs[icolumn] = longval;
+        columnFirsts[icolumn] = first;
+    }
+
+    void RowFilter::parse(string newExpression) {
+        delete root;
+        root = NULL;
+
+        expression = newExpression;
+        columnNames.clear();
+        columnDoubles.clear();
+        columnLongs.clear();
+        columnFirsts.clear();
+
+        pos = 0;
+        nextToken();
+        root = parseOr();
+        if (tokenType != TK_END) {
+            parseError("unexpected '" + token + "'");
+        }
+
+        allocateBuffers(root);
+    }
+
+    void RowFilter::parseError(string msg) {
+        string s = "RowFilter: Error in expression '" + expression + "': " + msg;
+        GalacticusIngest_error(s.c_str());
+    }
+
+    void RowFilter::nextToken() {
+        // split the expression into numbers, identifiers and operators
+        while (pos < expression.size() && isspace(expression[pos])) {
+            pos++;
+        }
+        token = "";
+        if (pos >= expression.size()) {
+            tokenType = TK_END;
+            return;
+        }
+
+        char c = expression[pos];
+        if (isdigit(c) || (c == '.' && pos+1 < expression.size() && isdigit(expression[pos+1]))) {
+            const char *start = expression.c_str() + pos;
+            char *end;
+            strtod(start, &end);
+            token = expression.substr(pos, end - start);
+            pos += end - start;
+            tokenType = TK_NUMBER;
+        } else if (isalpha(c) || c == '_') {
+            // dataset names may contain colons, e.g. totalLuminositiesStellar:SDSS_g:observed:dustAtlas
+            string::size_type start = pos;
+            while (pos < expression.size() && (isalnum(expression[pos]) || expression[pos] == '_' || expression[pos] == ':')) {
+                pos++;
+            }
+            // components of multi-dimensional datasets, e.g. velocity[1]
+            if (pos < expression.size() && expression[pos] == '[') {
+                string::size_type close = pos + 1;
+                while (close < expression.size() && isdigit(expression[close])) {
+                    close++;
+                }
+                if (close == pos + 1 || close >= expression.size() || expression[close] != ']') {
+                    parseError("invalid component index");
+                }
+                pos = close + 1;
+            }
+            token = expression.substr(start, pos - start);
+            tokenType = TK_IDENT;
+        } else {
+            string two = expression.substr(pos, 2);
+            if (two == "<=" || two == ">=" || two == "==" || two == "!=" || two == "&&" || two == "||") {
+                token = two;
+                pos += 2;
+            } else if (string("+-*/<>!()").find(c) != string::npos) {
+                token = string(1, c);
+                pos++;
+            } else {
+                parseError(string("unknown character '") + c + "'");
+            }
+            tokenType = TK_OP;
+        }
+    }
+
+    FilterNode* RowFilter::parseOr() {
+        FilterNode *node = parseAnd();
+        while (tokenType == TK_OP && token == "||") {
+            nextToken();
+            FilterNode *n = new FilterNode();
+            n->type = FN_BINARY;
+            n->op = OP_OR;
+            n->left = node;
+            n->right = parseAnd();
+            node = n;
+        }
+        return node;
+    }
+
+    FilterNode* RowFilter::parseAnd() {
+        FilterNode *node = parseComparison();
+        while (tokenType == TK_OP && token == "&&") {
+            nextToken();
+            FilterNode *n = new FilterNode();
+            n->type = FN_BINARY;
+            n->op = OP_AND;
+            n->left = node;
+            n->right = parseComparison();
+            node = n;
+        }
+        return node;
+    }
+
+    FilterNode* RowFilter::parseComparison() {
+        FilterNode *node = parseSum();
+        if (tokenType == TK_OP) {
+            int op = -1;
+            if (token == "<") op = OP_LT;
+            else if (token == "<=") op = OP_LE;
+            else if (token == ">") op = OP_GT;
+            else if (token == ">=") op = OP_GE;
+            else if (token == "==") op = OP_EQ;
+            else if (token == "!=") op = OP_NE;
+
+            if (op >= 0) {
+                nextToken();
+                FilterNode *n = new FilterNode();
+                n->type = FN_BINARY;
+                n->op = op;
+                n->left = node;
+                n->right = parseSum();
+                node = n;
+            }
+        }
+        return node;
+    }
+
+    FilterNode* RowFilter::parseSum() {
+        FilterNode *node = parseProduct();
+        while (tokenType == TK_OP && (token == "+" || token == "-")) {
+            FilterNode *n = new FilterNode();
+            n->type = FN_BINARY;
+            n->op = (token == "+") ? OP_ADD : OP_SUB;
+            nextToken();
+            n->left = node;
+            n->right = parseProduct();
+            node = n;
+        }
+        return node;
+    }
+
+    FilterNode* RowFilter::parseProduct() {
+        FilterNode *node = parseUnary();
+        while (tokenType == TK_OP && (token == "*" || token == "/")) {
+            FilterNode *n = new FilterNode();
+            n->type = FN_BINARY;
+            n->op = (token == "*") ? OP_MUL : OP_DIV;
+            nextToken();
+            n->left = node;
+            n->right = parseUnary();
+            node = n;
+        }
+        return node;
+    }
+
+    FilterNode* RowFilter::parseUnary() {
+        if (tokenType == TK_OP && (token == "-" || token == "!")) {
+            FilterNode *n = new FilterNode();
+            n->type = FN_UNARY;
+            n->op = (token == "-") ? OP_NEG : OP_NOT;
+            nextToken();
+            n->left = parseUnary();
+            return n;
+        }
+        return parsePrimary();
+    }
+
+    FilterNode* RowFilter::parsePrimary() {
+        FilterNode *node;
+
+        if (tokenType == TK_NUMBER) {
+            node = new FilterNode();
+            node->type = FN_NUMBER;
+            node->value = atof(token.c_str());
+            nextToken();
+            return node;
+        }
+
+        if (tokenType == TK_OP && token == "(") {
+            nextToken();
+            node = parseOr();
+            if (tokenType != TK_OP || token != ")") {
+                parseError("missing ')'");
+            }
+            nextToken();
+            return node;
+        }
+
+        if (tokenType != TK_IDENT) {
+            parseError("unexpected '" + token + "'");
+        }
+
+        string name = token;
+        nextToken();
+        node = new FilterNode();
+        node->name = name;
+
+        if (tokenType == TK_OP && token == "(") {
+            // function call
+            node->type = FN_FUNCTION;
+            if (name == "log10") {
+                node->op = OP_LOG10;
+            } else if (name == "abs") {
+                node->op = OP_ABS;
+            } else if (name == "sqrt") {
+                node->op = OP_SQRT;
+            } else {
+                parseError("unknown function '" + name + "'");
+            }
+            nextToken();
+            node->left = parseOr();
+            if (tokenType != TK_OP || token != ")") {
+                parseError("missing ')'");
+            }
+            nextToken();
+            return node;
+        }
+
+        if (constants.find(name) != constants.end()) {
+            node->type = FN_CONSTANT;
+            return node;
+        }
+
+        // everything else must be a dataset name
+        node->type = FN_COLUMN;
+        for (size_t i=0; i<columnNames.size(); i++) {
+            if (columnNames[i] == name) {
+                node->icolumn = i;
+            }
+        }
+        if (node->icolumn < 0) {
+            node->icolumn = columnNames.size();
+            columnNames.push_back(name);
+            columnDoubles.push_back(NULL);
+            columnLongs.push_back(NULL);
+            columnFirsts.push_back(0);
+        }
+        return node;
+    }
+
+    void RowFilter::allocateBuffers(FilterNode *node) {
+        if (!node) {
+            return;
+        }
+        node->tmp = new double[FILTER_BLOCKSIZE];
+        allocateBuffers(node->left);
+        allocateBuffers(node->right);
+    }
+
+    void RowFilter::evaluateNode(FilterNode *node, long start, long n) {
+        // evaluate n rows, starting at row start, into node->tmp;
+        // if rows are given (see evaluate with candidates), start is an
+        // offset into the rows-array instead
+        double *r = node->tmp;
+        double *a;
+        double *b;
+        long i;
+
+        switch (node->type) {
+            case FN_NUMBER:
+                for (i=0; i<n; i++) r[i] = node->value;
+                break;
+
+            case FN_CONSTANT:
+                node->value = constants[node->name];
+                for (i=0; i<n; i++) r[i] = node->value;
+                break;
+
+            case FN_COLUMN:
+                if (candidateRows) {
+                    const long *rows = candidateRows + start;
+                    long first = columnFirsts[node->icolumn];
+                    if (columnDoubles[node->icolumn]) {
+                        double *d = columnDoubles[node->icolumn];
+                        for (i=0; i<n; i++) r[i] = d[rows[i] - first];
+                    } else {
+                        long *l = columnLongs[node->icolumn];
+                        for (i=0; i<n; i++) r[i] = (double) l[rows[i] - first];
+                    }
+                } else {
+                    // without candidate rows, the columns are complete
+                    if (columnDoubles[node->icolumn]) {
+                        double *d = columnDoubles[node->icolumn] + start;
+                        for (i=0; i<n; i++) r[i] = d[i];
+                    } else {
+                        long *l = columnLongs[node->icolumn] + start;
+                        for (i=0; i<n; i++) r[i] = (double) l[i];
+                    }
+                }
+                break;
+
+            case FN_UNARY:
+                evaluateNode(node->left, start, n);
+                a = node->left->tmp;
+                if (node->op == OP_NEG) {
+                    for (i=0; i<n; i++) r[i] = -a[i];
+                } else {
+                    for (i=0; i<n; i++) r[i] = (a[i] == 0);
+                }
+                break;
+
+            case FN_FUNCTION:
+                evaluateNode(node->left, start, n);
+                a = node->left->tmp;
+                if (node->op == OP_LOG10) {
+                    for (i=0; i<n; i++) r[i] = log10(a[i]);
+                } else if (node->op == OP_ABS) {
+                    for (i=0; i<n; i++) r[i] = fabs(a[i]);
+                } else {
+                    for (i=0; i<n; i++) r[i] = sqrt(a[i]);
+                }
+                break;
+
+            case FN_BINARY:
+                evaluateNode(node->left, start, n);
+                evaluateNode(node->right, start, n);
+                a = node->left->tmp;
+                b = node->right->tmp;
+                switch (node->op) {
+                    case OP_ADD: for (i=0; i<n; i++) r[i] = a[i] + b[i]; break;
+                    case OP_SUB: for (i=0; i<n; i++) r[i] = a[i] - b[i]; break;
+                    case OP_MUL: for (i=0; i<n; i++) r[i] = a[i] * b[i]; break;
+                    case OP_DIV: for (i=0; i<n; i++) r[i] = a[i] / b[i]; break;
+                    case OP_LT:  for (i=0; i<n; i++) r[i] = (a[i] <  b[i]); break;
+                    case OP_LE:  for (i=0; i<n; i++) r[i] = (a[i] <= b[i]); break;
+                    case OP_GT:  for (i=0; i<n; i++) r[i] = (a[i] >  b[i]); break;
+                    case OP_GE:  for (i=0; i<n; i++) r[i] = (a[i] >= b[i]); break;
+                    case OP_EQ:  for (i=0; i<n; i++) r[i] = (a[i] == b[i]); break;
+                    case OP_NE:  for (i=0; i<n; i++) r[i] = (a[i] != b[i]); break;
+                    case OP_AND: for (i=0; i<n; i++) r[i] = (a[i] != 0) & (b[i] != 0); break;
+                    case OP_OR:  for (i=0; i<n; i++) r[i] = (a[i] != 0) | (b[i] != 0); break;
+                }
+                break;
+        }
+    }
+
+    long RowFilter::evaluate(long nvalues, vector<long> &selection) {
+        // evaluate the expression for rows 0 ... nvalues-1 and store
+        // the indices of all matching rows in selection
+        long n;
+
+        if (!root) {
+            GalacticusIngest_error("RowFilter: No expression given.");
+        }
+
+        selection.clear();
+        candidateRows = NULL;
+        for (long start=0; start<nvalues; start+=FILTER_BLOCKSIZE) {
+            n = nvalues - start;
+            if (n > FILTER_BLOCKSIZE) {
+                n = FILTER_BLOCKSIZE;
+            }
+            evaluateNode(root, start, n);
+            for (long i=0; i<n; i++) {
+                if (root->tmp[i] != 0) {
+                    selection.push_back(start + i);
+                }
+            }
+        }
+
+        return selection.size();
+    }
+
+    long RowFilter::evaluate(const vector<long> &candidates, vector<long> &selection) {
+        // same as above, but only check the given (sorted) candidate rows
+        long n;
+        long ncandidates = candidates.size();
+
+        if (!root) {
+            GalacticusIngest_error("RowFilter: No expression given.");
+        }
+
+        selection.clear();
+        if (ncandidates == 0) {
+            return 0;
+        }
+        candidateRows = &candidates[0];
+        for (long start=0; start<ncandidates; start+=FILTER_BLOCKSIZE) {
+            n = ncandidates - start;
+            if (n > FILTER_BLOCKSIZE) {
+                n = FILTER_BLOCKSIZE;
+            }
+            evaluateNode(root, start, n);
+            for (long i=0; i<n; i++) {
+                if (root->tmp[i] != 0) {
+                    selection.push_back(candidateRows[start + i]);
+                }
+            }
+        }
+        candidateRows = NULL;
+
+        return selection.size();
+    }
+
+}
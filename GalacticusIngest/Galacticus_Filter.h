@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifndef Galacticus_Galacticus_Filter_h
+#define Galacticus_Galacticus_Filter_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // one node of the parsed filter expression
+    class FilterNode {
+        public:
+            int type;       // number, column, constant, unary/binary operator or function
+            int op;
+            double value;   // for numbers and constants
+            string name;    // for columns, constants and functions
+            int icolumn;    // index into the column list of the filter
+            FilterNode *left;
+            FilterNode *right;
+            double *tmp;    // result buffer for one evaluation block
+
+            FilterNode();
+            ~FilterNode();
+    };
+
+
+    // Boolean/arithmetic expression on dataset columns, like
+    //   diskMassStellar*h > 1e9 && satelliteStatus == 0
+    // The expression is evaluated vectorized, i.e. node by node over blocks
+    // of rows, and returns the indices of all rows that fulfill it.
+    class RowFilter {
+        private:
+            string expression;
+            FilterNode *root;
+
+            // parser state
+            string::size_type pos;
+            string token;
+            int tokenType;
+
+            // columns used in the expression and pointers to their data,
+            // which must be bound by the reader for each output
+            vector<string> columnNames;
+            vector<double*> columnDoubles;
+            vector<long*> columnLongs;
+            vector<long> columnFirsts;  // row of the first value of each column
+
+            // named constants, e.g. h (Hubble parameter), snapnum, scale
+            map<string,double> constants;
+
+            // rows to evaluate, if only candidate rows are checked
+            const long *candidateRows;
+
+            void nextToken();
+            FilterNode* parseOr();
+            FilterNode* parseAnd();
+            FilterNode* parseComparison();
+            FilterNode* parseSum();
+            FilterNode* parseProduct();
+            FilterNode* parseUnary();
+            FilterNode* parsePrimary();
+            void parseError(string msg);
+
+            void allocateBuffers(FilterNode *node);
+            void evaluateNode(FilterNode *node, long start, long n);
+
+        public:
+            RowFilter();
+            RowFilter(string newExpression);
+            ~RowFilter();
+
+            void parse(string newExpression);
+            string getExpression();
+
+            void setConstant(string name, double value);
+
+            vector<string> getColumnNames();
+            void bindColumn(int icolumn, double *doubleval, long *longval, long first = 0);
+
+            long evaluate(long nvalues, vector<long> &selection);
+            long evaluate(const vector<long> &candidates, vector<long> &selection);
+    };
+
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Galacticus_History.h"
+
+// each record: nodeIndex, snapnum, one 8 byte slot per item, null flags (padded)
+#define HISTORY_SLOTSIZE 8
+#define HISTORY_HEADERSIZE 16
+#define HISTORY_MAXBUCKETS 1024
+#define HISTORY_SAMPLESPERBUCKET 100
+
+namespace Galacticus {
+
+    // sort records by nodeIndex, then snapnum
+    class HistoryRecordLess {
+        private:
+            const char *data;
+            long recordSize;
+
+        public:
+            HistoryRecordLess(const char *newData, long newRecordSize) {
+                data = newData;
+                recordSize = newRecordSize;
+            }
+
+            bool operator()(long a, long b) const {
+                const long *ra = (const long*) (data + a * recordSize);
+                const long *rb = (const long*) (data + b * recordSize);
+                if (ra[0] != rb[0]) {
+                    return ra[0] < rb[0];
+                }
+                return ra[1] < rb[1];
+            }
+    };
+
+
+    HistoryReader::HistoryReader() {
+        source = NULL;
+        distributed = false;
+    }
+
+    HistoryReader::HistoryReader(GalacticusReader *newSource, DBDataSchema::Schema *schema, string newTmpDir, long newMemoryBytes) {
+        DBDataSchema::DataObjDesc *item;
+
+        source = newSource;
+        tmpDir = newTmpDir;
+        if (tmpDir == "") {
+            tmpDir = ".";
+        }
+        memoryBytes = newMemoryBytes;
+
+        for (size_t i=0; i<schema->getArrSchemaItems().size(); i++) {
+            item = schema->getArrSchemaItems().at(i)->getDataDesc();
+            if (DBDataSchema::getByteLenOfDType(item->getDataObjDType()) > HISTORY_SLOTSIZE) {
+                cout << "ERROR: Column " << schema->getArrSchemaItems().at(i)->getColumnName()
+                     << " has a data type that is not supported in history mode." << endl;
+                abort();
+            }
+            items.add(item);
+        }
+
+        recordSize = HISTORY_HEADERSIZE + items.size() * HISTORY_SLOTSIZE + ((items.size() + 7) / 8) * 8;
+
+        numBuckets = 0;
+        distributed = false;
+        currentBucket = -1;
+        currentRecord = 0;
+        numRows = 0;
+    }
+
+    HistoryReader::~HistoryReader() {
+        // remove bucket files that were not read (e.g. after an error)
+        for (size_t b=0; b<bucketStreams.size(); b++) {
+            if (bucketStreams[b]) {
+                fclose(bucketStreams[b]);
+            }
+        }
+        for (size_t b=currentBucket+1; b<bucketFiles.size(); b++) {
+            boost::filesystem::remove(bucketFiles[b]);
+        }
+    }
+
+    void HistoryReader::distribute() {
+        // read all rows from the source and write them to the bucket files
+        vector<char> record(recordSize);
+        long *header = (long*) &record[0];
+        char *values = &record[HISTORY_HEADERSIZE];
+        char *nulls = values + items.size() * HISTORY_SLOTSIZE;
+        long totalRows;
+        int b;
+        boost::posix_time::ptime startTime;
+        boost::posix_time::ptime endTime;
+
+        startTime = boost::posix_time::microsec_clock::universal_time();
+
+        // enough buckets, so that each of them fits into memory together
+        // with its sort order
+        totalRows = source->getNumRowsInOutputs();
+        numBuckets = (int) ((totalRows * (recordSize + (long) sizeof(long))) / memoryBytes) + 1;
+        if (numBuckets > HISTORY_MAXBUCKETS) {
+            cout << "WARNING: Need " << numBuckets << " buckets for history mode, using " << HISTORY_MAXBUCKETS
+                 << " instead; the buckets may not fit into the given memory." << endl;
+            numBuckets = HISTORY_MAXBUCKETS;
+        }
+
+        // each bucket holds a range of node indices, so that the buckets in
+        // their order give all rows sorted by nodeIndex; the ranges are split
+        // at quantiles of a sample of the node indices of all outputs
+        splitters.clear();
+        if (numBuckets > 1) {
+            vector<long> sample;
+            source->sampleNodeIndices(numBuckets * HISTORY_SAMPLESPERBUCKET, sample);
+            sort(sample.begin(), sample.end());
+            for (b=1; b<numBuckets && sample.size() > 0; b++) {
+                splitters.push_back(sample[(b * sample.size()) / numBuckets]);
+            }
+        }
+
+        for (b=0; b<numBuckets; b++) {
+            stringstream ss;
+            ss << tmpDir << "/history_" << source->getFileNum() << "_" << getpid() << "_" << b << ".tmp";
+            bucketFiles.push_back(ss.str());
+            bucketStreams.push_back(fopen(ss.str().c_str(), "wb"));
+            if (!bucketStreams.back()) {
+                cout << "ERROR: Cannot open bucket file " << ss.str() << " for history mode." << endl;
+                abort();
+            }
+            bucketRows.push_back(0);
+        }
+
+        memset(&record[0], 0, recordSize);
+        while (source->getNextRow()) {
+            header[0] = source->getNodeIndex();
+            header[1] = source->getCurrentSnapnum();
+            for (size_t i=0; i<items.size(); i++) {
+                nulls[i] = source->getItemInRow(items[i], true, true, values + i*HISTORY_SLOTSIZE);
+            }
+
+            b = upper_bound(splitters.begin(), splitters.end(), header[0]) - splitters.begin();
+            if (fwrite(&record[0], recordSize, 1, bucketStreams[b]) != 1) {
+                cout << "ERROR: Cannot write to bucket file " << bucketFiles[b] << endl;
+                abort();
+            }
+            bucketRows[b]++;
+        }
+
+        for (b=0; b<numBuckets; b++) {
+            fclose(bucketStreams[b]);
+            bucketStreams[b] = NULL;
+        }
+
+        endTime = boost::posix_time::microsec_clock::universal_time();
+        printf("Time for distributing rows into %d history buckets: %lld ms\n", numBuckets, (long long int) (endTime-startTime).total_milliseconds());
+        fflush(stdout);
+
+        distributed = true;
+    }
+
+    bool HistoryReader::loadNextBucket() {
+        // read the next non-empty bucket and sort it, return false at the end
+        FILE *f;
+        long n;
+
+        vector<char>().swap(records);
+        order.clear();
+
+        while (++currentBucket < numBuckets) {
+            n = bucketRows[currentBucket];
+            if (n > 0) {
+                records.resize(n * recordSize);
+                f = fopen(bucketFiles[currentBucket].c_str(), "rb");
+                if (!f || fread(&records[0], recordSize, n, f) != (size_t) n) {
+                    cout << "ERROR: Cannot read bucket file " << bucketFiles[currentBucket] << endl;
+                    abort();
+                }
+                fclose(f);
+            }
+            boost::filesystem::remove(bucketFiles[currentBucket]);
+
+            if (n > 0) {
+                order.resize(n);
+                for (long i=0; i<n; i++) {
+                    order[i] = i;
+                }
+                sort(order.begin(), order.end(), HistoryRecordLess(&records[0], recordSize));
+                currentRecord = -1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    char *HistoryReader::getRecord(long n) {
+        return &records[order[n] * recordSize];
+    }
+
+    int HistoryReader::getNextRow() {
+        if (!distributed) {
+            distribute();
+        }
+
+        currentRecord++;
+        while (currentRecord >= (long) order.size()) {
+            if (!loadNextBucket()) {
+                printf("History mode: %ld rows in node-major order\n", numRows);
+                fflush(stdout);
+                return 0;
+            }
+            currentRecord++;
+        }
+
+        numRows++;
+        return 1;
+    }
+
+    int HistoryReader::getIndex(DBDataSchema::DataObjDesc *item) {
+        int i = items.find(item);
+        if (i < 0) {
+            cout << "ERROR: Item " << item->getDataObjName() << " is not part of the schema used for history mode." << endl;
+            abort();
+        }
+        return i;
+    }
+
+    bool HistoryReader::getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result) {
+        int i = getIndex(thisItem);
+        char *record = getRecord(currentRecord);
+        char *values = record + HISTORY_HEADERSIZE;
+        char *nulls = values + items.size() * HISTORY_SLOTSIZE;
+
+        memcpy(result, values + i*HISTORY_SLOTSIZE, DBDataSchema::getByteLenOfDType(thisItem->getDataObjDType()));
+        return nulls[i];
+    }
+
+    void HistoryReader::getConstItem(DBDataSchema::DataObjDesc * thisItem, void* result) {
+        source->getConstItem(thisItem, result);
+    }
+
+    void HistoryReader::openFile(string newFileName) {
+        source->openFile(newFileName);
+    }
+
+    void HistoryReader::closeFile() {
+        source->closeFile();
+    }
+
+}
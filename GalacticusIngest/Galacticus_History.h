@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <Reader.h>
+#include <Schema.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Galacticus_Reader.h"
+#include "Galacticus_ItemIndex.h"
+
+#ifndef Galacticus_Galacticus_History_h
+#define Galacticus_Galacticus_History_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // Returns the rows of all outputs in node-major order, i.e. the history
+    // of each node (sorted by snapnum) as one contiguous sequence of rows.
+    // First all rows are read from the GalacticusReader and distributed by
+    // nodeIndex range into bucket files; then the buckets are read back
+    // one by one and sorted in memory, so at most one bucket needs to fit
+    // into memory.
+    class HistoryReader : public DBReader::Reader {
+        private:
+            GalacticusReader *source;
+            ItemIndex items;
+
+            string tmpDir;
+            long memoryBytes;
+            int numBuckets;
+            vector<long> splitters;     // first nodeIndex of buckets 1 ... numBuckets-1
+            long recordSize;
+            vector<string> bucketFiles;
+            vector<FILE*> bucketStreams;
+            vector<long> bucketRows;
+
+            bool distributed;
+            int currentBucket;
+            vector<char> records;       // records of the current bucket
+            vector<long> order;         // sorted record numbers
+            long currentRecord;
+            long numRows;
+
+            void distribute();
+            bool loadNextBucket();
+            char *getRecord(long n);
+            int getIndex(DBDataSchema::DataObjDesc *item);
+
+        public:
+            HistoryReader();
+            HistoryReader(GalacticusReader *newSource, DBDataSchema::Schema *schema, string newTmpDir, long newMemoryBytes);
+            ~HistoryReader();
+
+            void openFile(string newFileName);
+            void closeFile();
+            int getNextRow();
+            bool getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result);
+            void getConstItem(DBDataSchema::DataObjDesc * thisItem, void* result);
+    };
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <sstream>
+#include <fcntl.h>
+
+#include "Galacticus_IOProfile.h"
+
+// chunks are usually small, so use many slots (should be a prime number)
+#define IOPROFILE_CACHESLOTS 12421
+
+namespace Galacticus {
+
+    IOProfile::IOProfile() {
+        set("default", 0);
+    }
+
+    bool IOProfile::set(const string newName, long cacheBytes) {
+        core = false;
+        sieveBytes = 0;
+        chunkCacheBytes = 0;
+        pageBufferBytes = 0;
+        advise = false;
+
+        if (newName.compare("default") == 0) {
+            // nothing to change
+        } else if (newName.compare("core") == 0) {
+            core = true;
+        } else if (newName.compare("lustre") == 0) {
+            sieveBytes = 4 * 1048576;
+            chunkCacheBytes = cacheBytes;
+            advise = true;
+        } else if (newName.compare("paged") == 0) {
+            chunkCacheBytes = cacheBytes;
+            pageBufferBytes = cacheBytes;
+        } else {
+            return false;
+        }
+
+        name = newName;
+        return true;
+    }
+
+    FileAccPropList IOProfile::getFileAccess(bool withPageBuffer) const {
+        FileAccPropList fapl;
+        if (core) {
+            // read the complete file on opening, never write it back
+            fapl.setCore(64 * 1048576, false);
+        }
+        if (sieveBytes > 0) {
+            fapl.setSieveBufSize(sieveBytes);
+        }
+        if (withPageBuffer && pageBufferBytes > 0) {
+            H5Pset_page_buffer_size(fapl.getId(), pageBufferBytes, 0, 0);
+        }
+        return fapl;
+    }
+
+    DSetAccPropList IOProfile::getDataSetAccess(long bytesNeeded) const {
+        DSetAccPropList dapl;
+        if (chunkCacheBytes > 0) {
+            // keep all chunks of the dataset, so that components of
+            // N x 3 datasets do not read the same chunks again;
+            // w0 = 1, since chunks are never written
+            long nbytes = (bytesNeeded < chunkCacheBytes) ? bytesNeeded : chunkCacheBytes;
+            dapl.setChunkCache(IOPROFILE_CACHESLOTS, nbytes, 1.0);
+        }
+        return dapl;
+    }
+
+    void IOProfile::adviseFile(H5File *file) const {
+        if (!advise || core) {
+            return;
+        }
+        int *fd = NULL;
+        file->getVFDHandle((void**) &fd);
+        if (fd) {
+            posix_fadvise(*fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+    }
+
+    void IOProfile::adviseDataSet(H5File *file, DataSet &dataset) const {
+        if (!advise || core) {
+            return;
+        }
+        haddr_t offset = H5Dget_offset(dataset.getId()); // undefined for chunked datasets
+        if (offset == HADDR_UNDEF) {
+            return;
+        }
+        int *fd = NULL;
+        file->getVFDHandle((void**) &fd);
+        if (fd) {
+            posix_fadvise(*fd, offset, dataset.getStorageSize(), POSIX_FADV_WILLNEED);
+        }
+    }
+
+    string IOProfile::describe() const {
+        stringstream ss;
+        ss << name;
+        if (chunkCacheBytes > 0) {
+            ss << ", chunk cache up to " << chunkCacheBytes / 1048576 << " MB";
+        }
+        if (pageBufferBytes > 0) {
+            ss << ", page buffer " << pageBufferBytes / 1048576 << " MB";
+        }
+        return ss.str();
+    }
+
+}
@@ -0,0 +1,66 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include "H5Cpp.h"
+
+#ifndef Galacticus_Galacticus_IOProfile_h
+#define Galacticus_Galacticus_IOProfile_h
+
+using namespace std;
+using namespace H5;
+
+namespace Galacticus {
+
+    // HDF5 access settings for different storage systems:
+    //   default: sec2 driver and the library's default caches
+    //   core:    each file is loaded completely into memory when it is opened
+    //   lustre:  large sieve buffer, chunk cache sized to the dataset that is
+    //            read, sequential access and readahead hints for the kernel
+    //   paged:   page buffer (only for files written with paged file space,
+    //            e.g. by h5repack -S PAGE) and chunk cache as for lustre
+    class IOProfile {
+        public:
+            string name;
+            bool core;              // core driver, whole file in memory
+            long sieveBytes;        // sieve buffer for contiguous datasets (0 = default)
+            long chunkCacheBytes;   // maximum chunk cache per dataset (0 = default)
+            long pageBufferBytes;   // page buffer per file (0 = none)
+            bool advise;            // posix_fadvise hints
+
+            IOProfile();
+
+            // select a profile by name, cacheBytes limits chunk cache and page buffer;
+            // returns false for unknown names
+            bool set(const string newName, long cacheBytes);
+
+            FileAccPropList getFileAccess(bool withPageBuffer) const;
+            // chunk cache for reading the given number of bytes of a chunked dataset
+            DSetAccPropList getDataSetAccess(long bytesNeeded) const;
+            // hints for the kernel: sequential access for the file,
+            // readahead for contiguous datasets that are going to be read
+            void adviseFile(H5File *file) const;
+            void adviseDataSet(H5File *file, DataSet &dataset) const;
+
+            string describe() const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include "Galacticus_ItemIndex.h"
+
+namespace Galacticus {
+
+    ItemIndex::ItemIndex() {
+        lastIndex = -1;
+    }
+
+    int ItemIndex::add(DBDataSchema::DataObjDesc *item) {
+        // append an item, return its index
+        itemIndex[item] = items.size();
+        items.push_back(item);
+        return items.size() - 1;
+    }
+
+    int ItemIndex::find(DBDataSchema::DataObjDesc *item) {
+        // index of the item, -1 if it is not in the list
+        int next = lastIndex + 1;
+        if (next >= (int) items.size()) {
+            next = 0;
+        }
+        if (next < (int) items.size() && items[next] == item) {
+            lastIndex = next;
+            return lastIndex;
+        }
+
+        map<DBDataSchema::DataObjDesc*, int>::iterator it = itemIndex.find(item);
+        if (it == itemIndex.end()) {
+            return -1;
+        }
+        lastIndex = it->second;
+        return lastIndex;
+    }
+
+    size_t ItemIndex::size() {
+        return items.size();
+    }
+
+    DBDataSchema::DataObjDesc *ItemIndex::operator[](size_t i) {
+        return items[i];
+    }
+
+}
@@ -0,0 +1,51 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <DataObjDesc.h>
+#include <vector>
+#include <map>
+
+#ifndef Galacticus_Galacticus_ItemIndex_h
+#define Galacticus_Galacticus_ItemIndex_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // Position of the schema items in a list, for the readers and collectors
+    // that keep one slot per item. The DBIngestor requests the items in the
+    // same order for each row, so the item after the last one found is
+    // checked first, before searching in the map.
+    class ItemIndex {
+        private:
+            vector<DBDataSchema::DataObjDesc*> items;
+            map<DBDataSchema::DataObjDesc*, int> itemIndex;
+            int lastIndex;
+
+        public:
+            ItemIndex();
+
+            int add(DBDataSchema::DataObjDesc *item);
+            int find(DBDataSchema::DataObjDesc *item);
+            size_t size();
+            DBDataSchema::DataObjDesc *operator[](size_t i);
+    };
+
+}
+
+#endif
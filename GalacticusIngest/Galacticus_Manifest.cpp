@@ -0,0 +1,240 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+
+#include "Galacticus_Manifest.h"
+
+namespace Galacticus {
+
+    // 64 bit FNV-1a hash, as hex string
+    static string hashString(const string &s) {
+        unsigned long h = 0xcbf29ce484222325UL;
+        char buf[17];
+        for (string::size_type i=0; i<s.length(); i++) {
+            h ^= (unsigned char) s[i];
+            h *= 0x100000001b3UL;
+        }
+        sprintf(buf, "%016lx", h);
+        return string(buf);
+    }
+
+    ManifestEntry::ManifestEntry() {
+        fileNum = 0;
+        snapnum = 0;
+        rows = 0;
+    }
+
+    IngestManifest::IngestManifest() {
+        manifestFile = "";
+    }
+
+    IngestManifest::IngestManifest(string newManifestFile, string newTable, string newPartition, string mapFile, string options) {
+        char host[256];
+
+        manifestFile = newManifestFile;
+        lockFile = manifestFile + string(".lock");
+        table = newTable;
+        partition = newPartition;
+
+        if (gethostname(host, sizeof(host)) != 0) {
+            strcpy(host, "localhost");
+        }
+        host[sizeof(host)-1] = '\0';
+        stringstream ss;
+        ss << host << "_" << getpid();
+        owner = ss.str();
+
+        ifstream mapStream(mapFile.c_str(), ios::in | ios::binary);
+        stringstream mapContent;
+        mapContent << mapStream.rdbuf();
+        configHash = hashString(mapContent.str() + string("\n") + options);
+
+        load(entries);
+        cout << "Read " << entries.size() << " entries from manifest " << manifestFile << endl;
+    }
+
+    string IngestManifest::getKey(const string entryTable, int fileNum, int snapnum, const string entryPartition) {
+        stringstream ss;
+        ss << entryTable << " " << fileNum << "/" << snapnum << " " << entryPartition;
+        return ss.str();
+    }
+
+    void IngestManifest::load(map<string, ManifestEntry> &target) {
+        // format: one line per output,
+        // output <dbase.table> <fileNum> <snapnum> <k/N> <rows> <configHash> <dataHash>
+        ifstream fileStream;
+        string line;
+        string word;
+
+        fileStream.open(manifestFile.c_str(), ios::in);
+        if (!fileStream) {
+            return; // nothing ingested yet
+        }
+
+        while (getline(fileStream, line)) {
+            if (line.length() == 0 || line[0] == '#') {
+                continue;
+            }
+            ManifestEntry e;
+            stringstream ss(line);
+            ss >> word >> e.table >> e.fileNum >> e.snapnum >> e.partition >> e.rows >> e.configHash >> e.dataHash;
+            if (word != "output" || ss.fail()) {
+                cout << "WARNING: Ignoring unexpected line '" << line << "' in manifest " << manifestFile << endl;
+                continue;
+            }
+            target[getKey(e.table, e.fileNum, e.snapnum, e.partition)] = e;
+        }
+
+        fileStream.close();
+    }
+
+    map<string, ManifestEntry>::iterator IngestManifest::findEntry(int fileNum, int snapnum) {
+        // the entry of this partition, or of the whole output, which contains it
+        map<string, ManifestEntry>::iterator it = entries.find(getKey(table, fileNum, snapnum, partition));
+        if (it == entries.end()) {
+            it = entries.find(getKey(table, fileNum, snapnum, string("1/1")));
+        }
+        return it;
+    }
+
+    bool IngestManifest::hasChanged(int fileNum, int snapnum, const string dataSignature) {
+        // an output of this table that was ingested from other data
+        map<string, ManifestEntry>::iterator it = findEntry(fileNum, snapnum);
+        if (it == entries.end() || it->second.dataHash == hashString(dataSignature)) {
+            return false;
+        }
+        cout << "ERROR: Snapnum " << snapnum << " of file " << fileNum << " was ingested into " << table << " before (" << it->second.rows
+             << " rows), but its datasets have changed since; delete these rows from the table and the line from manifest " << manifestFile << " first!" << endl;
+        return true;
+    }
+
+    bool IngestManifest::isComplete(int fileNum, int snapnum, const string dataSignature, long &rows) {
+        map<string, ManifestEntry>::iterator it = findEntry(fileNum, snapnum);
+        if (it == entries.end()) {
+            return false;
+        }
+
+        ManifestEntry &e = it->second;
+        if (hasChanged(fileNum, snapnum, dataSignature)) {
+            exit(EXIT_FAILURE);
+        }
+        if (e.configHash != configHash) {
+            cout << "WARNING: Snapnum " << snapnum << " of file " << fileNum << " was ingested before (" << e.rows
+                 << " rows), but the mapping has changed since; delete these rows from the table first!" << endl;
+            return false;
+        }
+
+        rows = e.rows;
+        return true;
+    }
+
+    void IngestManifest::addOutput(int fileNum, int snapnum, const string dataSignature, long rows) {
+        ManifestEntry e;
+        e.table = table;
+        e.fileNum = fileNum;
+        e.snapnum = snapnum;
+        e.partition = partition;
+        e.rows = rows;
+        e.configHash = configHash;
+        e.dataHash = hashString(dataSignature);
+        newEntries.push_back(e);
+    }
+
+    bool IngestManifest::lock() {
+        // create the lock file exclusively; a lock older than a minute is
+        // left over from a crashed process (saving takes a fraction of that)
+        for (int i=0; i<1200; i++) {
+            int fd = open(lockFile.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+            if (fd >= 0) {
+                close(fd);
+                return true;
+            }
+            if (errno != EEXIST) {
+                break;
+            }
+            if (i > 0 && i % 10 == 0 && boost::filesystem::exists(lockFile)
+                && difftime(time(NULL), boost::filesystem::last_write_time(lockFile)) > 60) {
+                cout << "WARNING: Removing stale lock " << lockFile << endl;
+                remove(lockFile.c_str());
+                continue;
+            }
+            usleep(100000);
+        }
+        cout << "WARNING: Cannot lock manifest " << manifestFile << " (" << lockFile << ")" << endl;
+        return false;
+    }
+
+    void IngestManifest::unlock() {
+        remove(lockFile.c_str());
+    }
+
+    void IngestManifest::save() {
+        // merge with the current file contents (other processes may have
+        // added outputs in the meantime) and replace the file in one go
+        map<string, ManifestEntry> merged;
+        string tmpFile = manifestFile + string(".") + owner + string(".tmp");
+
+        if (newEntries.size() == 0) {
+            return;
+        }
+
+        if (!lock()) {
+            return;
+        }
+
+        load(merged);
+        for (size_t i=0; i<newEntries.size(); i++) {
+            ManifestEntry &e = newEntries[i];
+            merged[getKey(e.table, e.fileNum, e.snapnum, e.partition)] = e;
+        }
+
+        ofstream fileStream;
+        fileStream.open(tmpFile.c_str(), ios::out | ios::trunc);
+        if (!fileStream) {
+            cout << "WARNING: Cannot write manifest " << tmpFile << endl;
+            unlock();
+            return;
+        }
+        fileStream << "# output <dbase.table> <fileNum> <snapnum> <k/N> <rows> <configHash> <dataHash>" << endl;
+        for (map<string, ManifestEntry>::iterator it = merged.begin(); it != merged.end(); it++) {
+            ManifestEntry &e = it->second;
+            fileStream << "output " << e.table << " " << e.fileNum << " " << e.snapnum << " " << e.partition << " "
+                       << e.rows << " " << e.configHash << " " << e.dataHash << endl;
+        }
+        fileStream.close();
+        boost::filesystem::rename(tmpFile, manifestFile);
+        unlock();
+
+        cout << "Added " << newEntries.size() << " outputs to manifest " << manifestFile << endl;
+        entries.swap(merged);
+        newEntries.clear();
+    }
+
+}
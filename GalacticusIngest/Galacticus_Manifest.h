@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifndef Galacticus_Galacticus_Manifest_h
+#define Galacticus_Galacticus_Manifest_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // one ingested output (or partition of it) of one data file (fileNum) into one table
+    class ManifestEntry {
+        public:
+            string table;       // dbase.table
+            int fileNum;
+            int snapnum;
+            string partition;   // k/N, 1/1 = whole output
+            long rows;
+            string configHash;  // hash of the field map and the row selection options
+            string dataHash;    // hash of the output's datasets (names, extents, storage sizes) in each file
+
+            ManifestEntry();
+    };
+
+
+    // Record of the outputs that were ingested completely, kept in a text
+    // file, so that a repeated ingest (e.g. after new outputs were added)
+    // can skip them without reading their datasets. An output is only
+    // skipped, if the field map and selection options have not changed
+    // since; an output whose datasets have changed is refused, because its
+    // rows would be inserted twice. Several processes (partitions, tables)
+    // can share one manifest: it is updated under a lock file.
+    class IngestManifest {
+        private:
+            string manifestFile;
+            string lockFile;
+            string owner;       // host name and process id
+            string table;
+            string partition;
+            string configHash;
+            map<string, ManifestEntry> entries; // key: see getKey
+            vector<ManifestEntry> newEntries;
+
+            string getKey(const string entryTable, int fileNum, int snapnum, const string entryPartition);
+            map<string, ManifestEntry>::iterator findEntry(int fileNum, int snapnum);
+            void load(map<string, ManifestEntry> &target);
+            bool lock();
+            void unlock();
+
+        public:
+            IngestManifest();
+            IngestManifest(string newManifestFile, string newTable, string newPartition, string mapFile, string options);
+
+            bool isComplete(int fileNum, int snapnum, const string dataSignature, long &rows);
+            bool hasChanged(int fileNum, int snapnum, const string dataSignature);
+            void addOutput(int fileNum, int snapnum, const string dataSignature, long rows);
+            void save();
+    };
+
+}
+
+#endif
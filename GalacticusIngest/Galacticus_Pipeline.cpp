@@ -0,0 +1,351 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Galacticus_Pipeline.h"
+#include "galacticusingest_error.h"
+
+// size of one value slot in a batch, large enough for all numeric types
+#define PIPELINE_SLOTSIZE 8
+
+namespace Galacticus {
+
+    static void backoff(int &spins) {
+        // spin shortly, then give the cpu away
+        spins++;
+        if (spins < 100) {
+            boost::this_thread::yield();
+        } else {
+            boost::this_thread::sleep(boost::posix_time::microseconds(50));
+        }
+    }
+
+    static double secondsSince(boost::posix_time::ptime startTime) {
+        return (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds() / 1.e6;
+    }
+
+
+    RowBatch::RowBatch() {
+        nrows = 0;
+        capacity = 0;
+        nitems = 0;
+    }
+
+    void RowBatch::allocate(long newCapacity, int newNitems) {
+        capacity = newCapacity;
+        nitems = newNitems;
+        nrows = 0;
+        values.resize(capacity * nitems * PIPELINE_SLOTSIZE);
+        nulls.resize(capacity * nitems);
+    }
+
+
+    PipelineReader::PipelineReader() {
+        source = NULL;
+        freeQueue = NULL;
+        fullQueue = NULL;
+        producer = NULL;
+    }
+
+    PipelineReader::PipelineReader(GalacticusReader *newSource, DBDataSchema::Schema *schema, int numQueueBatches, long batchRows) {
+        DBDataSchema::DataObjDesc *item;
+
+        source = newSource;
+
+        // the items are requested in schema order for each row
+        for (size_t i=0; i<schema->getArrSchemaItems().size(); i++) {
+            item = schema->getArrSchemaItems().at(i)->getDataDesc();
+            if (DBDataSchema::getByteLenOfDType(item->getDataObjDType()) > PIPELINE_SLOTSIZE) {
+                cout << "ERROR: Column " << schema->getArrSchemaItems().at(i)->getColumnName()
+                     << " has a data type that is not supported in pipelined mode." << endl;
+                abort();
+            }
+            items.add(item);
+        }
+
+        if (numQueueBatches < 2) {
+            numQueueBatches = 2;
+        }
+        if (batchRows < 1) {
+            batchRows = 1;
+        }
+
+        // all batches are allocated once and then only passed around
+        batches.resize(numQueueBatches);
+        freeQueue = new boost::lockfree::spsc_queue<RowBatch*>(numQueueBatches);
+        fullQueue = new boost::lockfree::spsc_queue<RowBatch*>(numQueueBatches);
+        for (int i=0; i<numQueueBatches; i++) {
+            batches[i].allocate(batchRows, items.size());
+            freeQueue->push(&batches[i]);
+        }
+
+        producer = NULL;
+        stopRequested = false;
+        producerDone = false;
+        producerFailed = false;
+        producerError = "";
+
+        current = NULL;
+        currentRow = 0;
+        finished = false;
+
+        segmentRows = 0;
+        rowsInSegment = 0;
+
+        numBatches = 0;
+        numRows = 0;
+        occupancySum = 0;
+        producerWaits = 0;
+        consumerWaits = 0;
+        producerWaitTime = 0;
+        consumerWaitTime = 0;
+    }
+
+    PipelineReader::~PipelineReader() {
+        stop();
+        delete freeQueue;
+        delete fullQueue;
+    }
+
+    void PipelineReader::start() {
+        if (producer) {
+            return;
+        }
+        producer = new boost::thread(&PipelineReader::produce, this);
+    }
+
+    void PipelineReader::stop() {
+        // ask the producer to finish (e.g. after an error in the sink)
+        // and wait for it, so that the reader is not used any more
+        if (!producer) {
+            return;
+        }
+        stopRequested = true;
+        producer->join();
+        delete producer;
+        producer = NULL;
+    }
+
+    void PipelineReader::produce() {
+        // producer thread: read complete rows into free batches
+        RowBatch *b = NULL;
+        char *values;
+        bool endOfData = false;
+        int spins;
+        boost::posix_time::ptime startTime;
+
+        try {
+            while (!endOfData && !stopRequested) {
+                if (!freeQueue->pop(b)) {
+                    // all batches are in the queue or at the sink
+                    producerWaits++;
+                    startTime = boost::posix_time::microsec_clock::universal_time();
+                    spins = 0;
+                    while (!freeQueue->pop(b)) {
+                        if (stopRequested) {
+                            break;
+                        }
+                        backoff(spins);
+                    }
+                    producerWaitTime += secondsSince(startTime);
+                    if (stopRequested) {
+                        break;
+                    }
+                }
+
+                b->nrows = 0;
+                while (b->nrows < b->capacity) {
+                    if (!source->getNextRow()) {
+                        endOfData = true;
+                        break;
+                    }
+                    values = &b->values[b->nrows * b->nitems * PIPELINE_SLOTSIZE];
+                    for (int i=0; i<b->nitems; i++) {
+                        b->nulls[b->nrows * b->nitems + i] = source->getItemInRow(items[i], true, true, values + i*PIPELINE_SLOTSIZE);
+                    }
+                    b->nrows++;
+                }
+
+                // cannot fail, the queue can hold all batches
+                fullQueue->push(b);
+            }
+        } catch (std::exception &e) {
+            producerError = e.what();
+            producerFailed = true;
+        } catch (H5::Exception &e) {
+            producerError = e.getDetailMsg();
+            producerFailed = true;
+        } catch (...) {
+            producerError = "unknown error";
+            producerFailed = true;
+        }
+
+        // must be set last, the consumer reads the error afterwards
+        producerDone = true;
+    }
+
+    int PipelineReader::getNextRow() {
+        int spins;
+        bool waited = false;
+        boost::posix_time::ptime startTime;
+
+        if (segmentRows > 0 && rowsInSegment >= segmentRows) {
+            return 0;
+        }
+        if (finished) {
+            return 0;
+        }
+        start();
+
+        if (current) {
+            currentRow++;
+            if (currentRow < current->nrows) {
+                rowsInSegment++;
+                return 1;
+            }
+            freeQueue->push(current);
+            current = NULL;
+        }
+
+        spins = 0;
+        while (!current) {
+            if (fullQueue->pop(current)) {
+                occupancySum += fullQueue->read_available();
+                if (current->nrows == 0) {
+                    // only possible for the last batch
+                    freeQueue->push(current);
+                    current = NULL;
+                }
+                continue;
+            }
+            if (producerDone) {
+                // check the queue again, the last batch may have been
+                // pushed just before producerDone was set
+                if (fullQueue->pop(current)) {
+                    if (current->nrows == 0) {
+                        freeQueue->push(current);
+                        current = NULL;
+                    }
+                    continue;
+                }
+                break;
+            }
+
+            // queue is empty, the sink is waiting for the reader
+            if (!waited) {
+                consumerWaits++;
+                startTime = boost::posix_time::microsec_clock::universal_time();
+                waited = true;
+            }
+            backoff(spins);
+        }
+        if (waited) {
+            consumerWaitTime += secondsSince(startTime);
+        }
+
+        if (!current) {
+            stop();
+            finished = true;
+            if (producerFailed) {
+                string msg = string("Reading rows failed in pipelined mode: ") + producerError;
+                GalacticusIngest_error(msg.c_str());
+            }
+            printMetrics();
+            return 0;
+        }
+
+        numBatches++;
+        numRows += current->nrows;
+        currentRow = 0;
+        rowsInSegment++;
+        return 1;
+    }
+
+    int PipelineReader::getIndex(DBDataSchema::DataObjDesc *item) {
+        int i = items.find(item);
+        if (i < 0) {
+            cout << "ERROR: Item " << item->getDataObjName() << " is not part of the schema used for the pipeline." << endl;
+            abort();
+        }
+        return i;
+    }
+
+    bool PipelineReader::getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result) {
+        int i = getIndex(thisItem);
+        long k = currentRow * current->nitems + i;
+
+        memcpy(result, &current->values[k * PIPELINE_SLOTSIZE], DBDataSchema::getByteLenOfDType(thisItem->getDataObjDType()));
+        return current->nulls[k];
+    }
+
+    void PipelineReader::getConstItem(DBDataSchema::DataObjDesc * thisItem, void* result) {
+        source->getConstItem(thisItem, result);
+    }
+
+    void PipelineReader::openFile(string newFileName) {
+        source->openFile(newFileName);
+    }
+
+    void PipelineReader::closeFile() {
+        stop();
+        source->closeFile();
+    }
+
+    void PipelineReader::setSegmentRows(long newSegmentRows) {
+        segmentRows = newSegmentRows;
+    }
+
+    void PipelineReader::startSegment() {
+        rowsInSegment = 0;
+    }
+
+    long PipelineReader::getRowsInSegment() {
+        return rowsInSegment;
+    }
+
+    bool PipelineReader::isFinished() {
+        return finished;
+    }
+
+    void PipelineReader::printMetrics() {
+        // mostly full queue: the sink is the bottleneck,
+        // mostly empty queue: the reader is the bottleneck
+        double meanOccupancy = 0;
+        if (numBatches > 0) {
+            meanOccupancy = (double) occupancySum / numBatches;
+        }
+
+        printf("Pipeline: %ld rows in %ld batches, mean queue occupancy %.2f of %ld batches\n",
+               numRows, numBatches, meanOccupancy, (long) batches.size());
+        printf("Pipeline: reader waited %ld times (%.3f s) for the sink, sink waited %ld times (%.3f s) for the reader\n",
+               producerWaits, producerWaitTime, consumerWaits, consumerWaitTime);
+        if (producerWaitTime > consumerWaitTime) {
+            printf("Pipeline: the database sink is the bottleneck\n");
+        } else {
+            printf("Pipeline: the file reader is the bottleneck\n");
+        }
+        fflush(stdout);
+    }
+
+}
@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <Reader.h>
+#include <Schema.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "Galacticus_Reader.h"
+#include "Galacticus_ItemIndex.h"
+
+#ifndef Galacticus_Galacticus_Pipeline_h
+#define Galacticus_Galacticus_Pipeline_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // a batch of rows with all values already converted, one slot of
+    // 8 bytes per item and row
+    class RowBatch {
+        public:
+            long nrows;
+            long capacity;
+            int nitems;
+            vector<char> values;
+            vector<char> nulls;
+
+            RowBatch();
+            void allocate(long newCapacity, int newNitems);
+    };
+
+
+    // Runs the GalacticusReader in a separate thread: the producer fills
+    // pre-allocated batches with complete rows and passes them through a
+    // bounded lock-free queue to this reader, which is read by the DBIngestor
+    // (sink) in the main thread. Empty batches go back via a second queue,
+    // so the producer waits as soon as all batches are in use (backpressure).
+    class PipelineReader : public DBReader::Reader {
+        private:
+            GalacticusReader *source;
+            ItemIndex items;
+
+            vector<RowBatch> batches;
+            boost::lockfree::spsc_queue<RowBatch*> *freeQueue;
+            boost::lockfree::spsc_queue<RowBatch*> *fullQueue;
+            boost::thread *producer;
+            boost::atomic<bool> stopRequested;
+            boost::atomic<bool> producerDone;
+            bool producerFailed;
+            string producerError;
+
+            RowBatch *current;
+            long currentRow;
+            bool finished;
+
+            long segmentRows;
+            long rowsInSegment;
+
+            // metrics
+            long numBatches;
+            long numRows;
+            long occupancySum;
+            long producerWaits;
+            long consumerWaits;
+            double producerWaitTime;
+            double consumerWaitTime;
+
+            void produce();
+            int getIndex(DBDataSchema::DataObjDesc *item);
+
+        public:
+            PipelineReader();
+            PipelineReader(GalacticusReader *newSource, DBDataSchema::Schema *schema, int numQueueBatches, long batchRows);
+            ~PipelineReader();
+
+            void start();
+            void stop();
+            void printMetrics();
+
+            void setSegmentRows(long newSegmentRows);
+            void startSegment();
+            long getRowsInSegment();
+            bool isFinished();
+
+            void openFile(string newFileName);
+            void closeFile();
+            int getNextRow();
+            bool getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result);
+            void getConstItem(DBDataSchema::DataObjDesc * thisItem, void* result);
+    };
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+#include <boost/thread.hpp>
+
+#include "Galacticus_RadixSort.h"
+
+#define RADIX_BITS 8
+#define RADIX_SIZE 256
+// below this number of rows, threads are not worth it
+#define RADIX_MINPARALLEL 1000000
+
+namespace Galacticus {
+
+    unsigned long getSortableKey(double value) {
+        // flip all bits of negative numbers, only the sign bit of positive ones
+        unsigned long u;
+        if (value != value) {
+            return ~0UL;
+        }
+        if (value == 0) {
+            value = 0; // -0 and +0 are equal
+        }
+        memcpy(&u, &value, sizeof(u));
+        if (u >> 63) {
+            return ~u;
+        }
+        return u | (1UL << 63);
+    }
+
+    unsigned long getSortableKey(long value) {
+        return ((unsigned long) value) ^ (1UL << 63);
+    }
+
+
+    // one part of the input, handled by one thread
+    class RadixPart {
+        public:
+            const unsigned long *keys;
+            const long *rows;
+            unsigned long *keysOut;
+            long *rowsOut;
+            long start;
+            long end;
+            int shift;
+            long count[RADIX_SIZE];
+            long offset[RADIX_SIZE];
+
+            void countDigits() {
+                memset(count, 0, sizeof(count));
+                for (long i=start; i<end; i++) {
+                    count[(keys[i] >> shift) & (RADIX_SIZE-1)]++;
+                }
+            }
+
+            void scatter() {
+                long pos;
+                for (long i=start; i<end; i++) {
+                    pos = offset[(keys[i] >> shift) & (RADIX_SIZE-1)]++;
+                    keysOut[pos] = keys[i];
+                    rowsOut[pos] = rows[i];
+                }
+            }
+    };
+
+    class RadixCountTask {
+        private:
+            RadixPart *part;
+        public:
+            RadixCountTask(RadixPart *newPart) {
+                part = newPart;
+            }
+            void operator()() {
+                part->countDigits();
+            }
+    };
+
+    class RadixScatterTask {
+        private:
+            RadixPart *part;
+        public:
+            RadixScatterTask(RadixPart *newPart) {
+                part = newPart;
+            }
+            void operator()() {
+                part->scatter();
+            }
+    };
+
+    void radixSortRows(vector<unsigned long> &keys, vector<long> &rows, int nthreads) {
+        long n = keys.size();
+        if (n < 2) {
+            return;
+        }
+
+        vector<unsigned long> keysTmp(n);
+        vector<long> rowsTmp(n);
+        unsigned long *keysIn = &keys[0];
+        long *rowsIn = &rows[0];
+        unsigned long *keysOut = &keysTmp[0];
+        long *rowsOut = &rowsTmp[0];
+        unsigned long *swapKeys;
+        long *swapRows;
+        long total;
+        bool trivial;
+
+        if (nthreads < 1 || n < RADIX_MINPARALLEL) {
+            nthreads = 1;
+        }
+
+        vector<RadixPart> parts(nthreads);
+        for (int t=0; t<nthreads; t++) {
+            parts[t].start = (n * t) / nthreads;
+            parts[t].end = (n * (t+1)) / nthreads;
+        }
+
+        for (int shift=0; shift<64; shift+=RADIX_BITS) {
+            for (int t=0; t<nthreads; t++) {
+                parts[t].keys = keysIn;
+                parts[t].rows = rowsIn;
+                parts[t].keysOut = keysOut;
+                parts[t].rowsOut = rowsOut;
+                parts[t].shift = shift;
+            }
+
+            if (nthreads == 1) {
+                parts[0].countDigits();
+            } else {
+                boost::thread_group threads;
+                for (int t=0; t<nthreads; t++) {
+                    threads.create_thread(RadixCountTask(&parts[t]));
+                }
+                threads.join_all();
+            }
+
+            // output positions: by digit, then by part (keeps it stable);
+            // a pass where all keys have the same digit can be skipped
+            total = 0;
+            trivial = false;
+            for (int d=0; d<RADIX_SIZE; d++) {
+                long digitTotal = 0;
+                for (int t=0; t<nthreads; t++) {
+                    parts[t].offset[d] = total;
+                    total += parts[t].count[d];
+                    digitTotal += parts[t].count[d];
+                }
+                if (digitTotal == n) {
+                    trivial = true;
+                }
+            }
+            if (trivial) {
+                continue;
+            }
+
+            if (nthreads == 1) {
+                parts[0].scatter();
+            } else {
+                boost::thread_group threads;
+                for (int t=0; t<nthreads; t++) {
+                    threads.create_thread(RadixScatterTask(&parts[t]));
+                }
+                threads.join_all();
+            }
+
+            swapKeys = keysIn;
+            keysIn = keysOut;
+            keysOut = swapKeys;
+            swapRows = rowsIn;
+            rowsIn = rowsOut;
+            rowsOut = swapRows;
+        }
+
+        // result is in the temporary arrays after an odd number of passes
+        if (keysIn != &keys[0]) {
+            keys.swap(keysTmp);
+            rows.swap(rowsTmp);
+        }
+    }
+
+}
@@ -0,0 +1,41 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <vector>
+
+#ifndef Galacticus_Galacticus_RadixSort_h
+#define Galacticus_Galacticus_RadixSort_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // map values to unsigned integers with the same order
+    // (NaN is sorted after +Inf)
+    unsigned long getSortableKey(double value);
+    unsigned long getSortableKey(long value);
+
+    // stable LSD radix sort (8 bits per pass) of rows by keys, both
+    // are sorted in place; histograms and scattering are done in
+    // parallel with nthreads threads for large inputs
+    void radixSortRows(vector<unsigned long> &keys, vector<long> &rows, int nthreads);
+
+}
+
+#endif
@@ -21,6 +21,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>   // sqrt, pow
+#include <string.h> // memset
+#include <limits>
+#include <algorithm>
 #include "galacticusingest_error.h"
 #include <list>
 //#include <boost/filesystem.hpp>
@@ -34,19 +37,72 @@
 //#include <boost/chrono.hpp>
 //#include <cmath>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp> // for sleeping in follow mode
+
+// default size of the HDF5 sieve buffer for contiguous datasets
+#define DEFAULT_SIEVE_BYTES 65536
 
 
 namespace Galacticus {
+    boost::recursive_mutex GalacticusReader::h5Mutex;
+
     GalacticusReader::GalacticusReader() {
         fp = NULL;
 
         currRow = 0;
+
+        filter = NULL;
+        useSelection = false;
+        blockLoaded = false;
+
+        rangeFilter = NULL;
+        zoneMap = NULL;
+        stats = NULL;
+        asserter = NULL;
+        aggregator = NULL;
+        checksums = NULL;
+        blockFailed = false;
+        manifest = NULL;
+        partitionIndex = 1;
+        numPartitions = 1;
+        usePageBuffer = true;
+        ioBytes = 0;
+        sampleFraction = 1;
+        sampleSeed = 0;
+        follow = false;
+        followDone = false;
+
+        segmentRows = 0;
+        rowsInSegment = 0;
+        finished = false;
+
+        progenitorSnapnum = -1;
+        descendantSnapnum = -1;
+        linkChunkRows = 1048576;
+        treeColumnsWarned = false;
+
+        sortKey = "";
+        sortThreads = 1;
     }
 
     GalacticusReader::GalacticusReader(string newFileName, int newFileNum, vector<int> newSnapnums, float newHubble_h) {
+        vector<string> newFileNames;
+        newFileNames.push_back(newFileName);
+        init(newFileNames, newFileNum, newSnapnums, newHubble_h);
+    }
+
+    GalacticusReader::GalacticusReader(vector<string> newFileNames, int newFileNum, vector<int> newSnapnums, float newHubble_h) {
+        init(newFileNames, newFileNum, newSnapnums, newHubble_h);
+    }
+
+    void GalacticusReader::init(vector<string> newFileNames, int newFileNum, vector<int> newSnapnums, float newHubble_h) {
+
+        if (newFileNames.size() == 0) {
+            GalacticusIngest_error("GalacticusReader: No data file given.\n");
+        }
 
         user_snapnums = newSnapnums;
-        fileName = newFileName;
+        fileName = newFileNames[0];
 
         // strip path from file name
         //boost::filesystem::path p(fileName);
@@ -63,15 +119,54 @@ namespace Galacticus {
         countInBlock = 0;   // counts values in each datablock (output)
         countSnap = 0;
 
+        filter = NULL;
+        useSelection = false;
+        numSelected = 0;
+        countSelected = 0;
+        blockLoaded = false;
+        selectChunkSize = 1024;
+
+        rangeFilter = NULL;
+        zoneMap = NULL;
+        zoneMapFile = "";
+        stats = NULL;
+        asserter = NULL;
+        aggregator = NULL;
+        checksums = NULL;
+        blockFailed = false;
+        manifest = NULL;
+        partitionIndex = 1;
+        numPartitions = 1;
+        usePageBuffer = true;
+        ioBytes = 0;
+        sampleFraction = 1;
+        sampleSeed = 0;
+        follow = false;
+        followDone = false;
+
+        segmentRows = 0;    // 0 = no segments, read everything at once
+        rowsInSegment = 0;
+        finished = false;
+
+        progenitorSnapnum = -1;
+        descendantSnapnum = -1;
+        linkChunkRows = 1048576;
+        treeColumnsWarned = false;
+
+        sortKey = "";
+        sortThreads = 1;
+
         // factors for constructing dbId, could/should be read from user input, actually
         snapnumfactor = 1000;
         rowfactor = 1000000;
 
         //const H5std_string FILE_NAME( "SDS.h5" );
-        openFile(newFileName);
+        for (size_t f=0; f<newFileNames.size(); f++) {
+            openFile(newFileNames[f]);
+        }
         //offsetFileStream();
 
-        // read expansion factors, output names etc.
+        // read expansion factors, output names etc. (from the first file)
         getOutputsMeta(numOutputs);
 
         // set numOutputs, if snapnums are given
@@ -93,33 +188,332 @@ namespace Galacticus {
 
     GalacticusReader::~GalacticusReader() {
         closeFile();
-        // delete data sets? i.e. call DataBlock::deleteData?
+        for (size_t k=0; k<datablocks.size(); k++) {
+            datablocks[k].deleteData();
+        }
+        delete filter;
+        for (size_t r=0; r<routeFilters.size(); r++) {
+            delete routeFilters[r];
+        }
+        delete rangeFilter;
+        delete zoneMap; // saves new zone maps
+        delete stats; // writes report, if not done yet
+        delete asserter;
+        delete aggregator; // writes the results, if not done yet
+        delete checksums;
     }
 
-    void GalacticusReader::openFile(string newFileName) {
-        // open file as hdf5-file
-        H5std_string h5fileName;
-        h5fileName = (H5std_string) newFileName;
+    void GalacticusReader::setFilter(string expression) {
+        // the filter is parsed only once; snapnum and scale are
+        // updated for each output before evaluating it
+        delete filter;
+        filter = new RowFilter();
+        filter->setConstant("h", hubble_h);
+        filter->setConstant("snapnum", 0);
+        filter->setConstant("scale", 0);
+        filter->parse(expression);
+    }
+
+    int GalacticusReader::addRoute(string expression) {
+        // condition for sending rows to a further table, returns the
+        // number of the route (its bit in the route mask)
+        if (routeFilters.size() >= 64) {
+            GalacticusIngest_error("GalacticusReader: At most 64 routes are possible.");
+        }
+        RowFilter *f = new RowFilter();
+        f->setConstant("h", hubble_h);
+        f->setConstant("snapnum", 0);
+        f->setConstant("scale", 0);
+        f->parse(expression);
+        routeFilters.push_back(f);
+        return routeFilters.size() - 1;
+    }
+
+    int GalacticusReader::getNumRoutes() {
+        return routeFilters.size();
+    }
+
+    unsigned long GalacticusReader::getRouteMask() {
+        // routes whose condition is fulfilled by the current row
+        return routeMasks[countInBlock];
+    }
+
+    void GalacticusReader::addRange(string rangeSpec) {
+        // rangeSpec is column:min:max; the column name itself may contain colons
+        string::size_type pos2 = rangeSpec.rfind(':');
+        string::size_type pos1 = string::npos;
+        if (pos2 != string::npos && pos2 > 0) {
+            pos1 = rangeSpec.rfind(':', pos2-1);
+        }
+        if (pos1 == string::npos || pos1 == 0) {
+            string msg = "GalacticusReader: Range '" + rangeSpec + "' must be given as column:min:max.";
+            GalacticusIngest_error(msg.c_str());
+        }
+
+        rangeColumns.push_back(rangeSpec.substr(0, pos1));
+        rangeMin.push_back(atof(rangeSpec.substr(pos1+1, pos2-pos1-1).c_str()));
+        rangeMax.push_back(atof(rangeSpec.substr(pos2+1).c_str()));
+
+        // (re)build the filter expression for checking single rows
+        stringstream ss;
+        ss.precision(17);
+        for (size_t i=0; i<rangeColumns.size(); i++) {
+            if (i > 0) {
+                ss << " && ";
+            }
+            ss << "(" << rangeColumns[i] << " >= " << rangeMin[i] << " && " << rangeColumns[i] << " <= " << rangeMax[i] << ")";
+        }
+        delete rangeFilter;
+        rangeFilter = new RowFilter(ss.str());
+
+        if (!zoneMap) {
+            zoneMap = new ZoneMap(fileNames, zoneMapFile);
+        }
+    }
+
+    void GalacticusReader::setStatsFile(string statsFile) {
+        delete stats;
+        stats = new StatsCollector(statsFile, fileName, fileNum);
+    }
+
+    void GalacticusReader::addAssertion(string column, string spec) {
+        if (!asserter) {
+            asserter = new BlockAsserter();
+        }
+        asserter->addAssertion(column, spec);
+    }
+
+    int GalacticusReader::getNumFailedOutputs() {
+        if (!asserter) {
+            return 0;
+        }
+        return asserter->getNumFailedOutputs();
+    }
+
+    void GalacticusReader::addAggregate(string spec, int numThreads) {
+        if (!aggregator) {
+            aggregator = new Aggregator(fileNum, numThreads);
+        }
+        aggregator->addAggregate(spec);
+    }
+
+    void GalacticusReader::setChecksumFile(string checksumFile, DBDataSchema::Schema *schema) {
+        delete checksums;
+        checksums = new ChecksumCollector(checksumFile, fileNum, schema);
+    }
+
+    void GalacticusReader::setProjection(vector<string> columns) {
+        projection.clear();
+        projection.insert(columns.begin(), columns.end());
+    }
+
+    int GalacticusReader::getNumComponents(const string matchname) {
+        // as for reading: 0 for a one-dimensional dataset of the current output,
+        // the number of components for a two-dimensional one, -1 if it was not read
+        if (dataSetMap.find(matchname) != dataSetMap.end()) {
+            return 0;
+        }
+        int n = 0;
+        while (true) {
+            stringstream ss;
+            ss << matchname << "[" << n << "]";
+            if (dataSetMap.find(ss.str()) == dataSetMap.end()) {
+                return (n > 0) ? n : -1;
+            }
+            n++;
+        }
+    }
+
+    bool GalacticusReader::readNextOutput(string &outputName, long &numRows) {
+        // read the next output completely (instead of row by row with getNextRow)
+        if (!nextOutput(outputName)) {
+            finished = true;
+            return false;
+        }
+        nvalues = readNextBlock(outputName);
+        numRows = nvalues;
+        blockLoaded = true;
+        countSelected = numSelected;
+        return true;
+    }
 
-        if (fp) {
-            fp->close();
-            delete fp;
+    void GalacticusReader::setSegmentRows(long newSegmentRows) {
+        segmentRows = newSegmentRows;
+    }
+
+    void GalacticusReader::startSegment() {
+        rowsInSegment = 0;
+    }
+
+    long GalacticusReader::getRowsInSegment() {
+        return rowsInSegment;
+    }
+
+    bool GalacticusReader::isFinished() {
+        return finished;
+    }
+
+    void GalacticusReader::setSortKey(string newSortKey, int newSortThreads) {
+        sortKey = newSortKey;
+        sortThreads = newSortThreads;
+    }
+
+    void GalacticusReader::setManifest(IngestManifest *newManifest) {
+        // the manifest is owned by the caller, who saves it after a successful ingest;
+        // refuse to start, if an output that was ingested already has changed
+        bool changed = false;
+        manifest = newManifest;
+        for (map<int, OutputMeta>::iterator it = outputMetaMap.begin(); it != outputMetaMap.end(); it++) {
+            if (user_snapnums.size() > 0 && find(user_snapnums.begin(), user_snapnums.end(), it->first) == user_snapnums.end()) {
+                continue;
+            }
+            if (manifest->hasChanged(fileNum, it->first, getOutputSignature(it->second.outputName))) {
+                changed = true;
+            }
+        }
+        if (changed) {
+            exit(EXIT_FAILURE);
         }
+    }
+
+    void GalacticusReader::setFollow(int newPollInterval, int newFollowTimeout, long newFollowOutputs) {
+        follow = true;
+        pollInterval = newPollInterval;
+        followTimeout = newFollowTimeout;
+        followOutputs = newFollowOutputs;
+        followDone = false;
+        lastNewOutput = time(NULL);
+    }
+
+    void GalacticusReader::setPartition(int newPartitionIndex, int newNumPartitions) {
+        // partition k of N (1 <= k <= N)
+        if (newNumPartitions < 1 || newPartitionIndex < 1 || newPartitionIndex > newNumPartitions) {
+            printf("ERROR: Invalid partition %d/%d, need 1 <= k <= N.\n", newPartitionIndex, newNumPartitions);
+            exit(EXIT_FAILURE);
+        }
+        partitionIndex = newPartitionIndex;
+        numPartitions = newNumPartitions;
+        checkRowFactor();
+    }
+
+    void GalacticusReader::setSample(double newSampleFraction, unsigned long newSampleSeed) {
+        if (newSampleFraction <= 0 || newSampleFraction > 1) {
+            printf("ERROR: Invalid sample fraction %g, must be > 0 and <= 1.\n", newSampleFraction);
+            exit(EXIT_FAILURE);
+        }
+        sampleFraction = newSampleFraction;
+        sampleSeed = newSampleSeed;
+    }
+
+    void GalacticusReader::checkRowFactor() {
+        // dbIds are only unique, if no output has more rows than rowfactor
+        map<int, OutputMeta>::iterator it;
+        long n;
+
+        for (it = outputMetaMap.begin(); it != outputMetaMap.end(); it++) {
+            if (user_snapnums.size() > 0 && find(user_snapnums.begin(), user_snapnums.end(), it->first) == user_snapnums.end()) {
+                continue;
+            }
+            n = getNumRowsInDataSet(it->second.outputName + string("/nodeIndex"));
+            if (n > rowfactor) {
+                printf("ERROR: %s has %ld rows, but only %ld rows per output are possible with unique dbIds (rowfactor).\n", it->second.outputName.c_str(), n, rowfactor);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    void GalacticusReader::setZoneMapFile(string newZoneMapFile) {
+        // must be called before adding ranges
+        zoneMapFile = newZoneMapFile;
+    }
+
+    void GalacticusReader::setIOProfile(string profileName, long cacheBytes) {
+        // the files are opened again with the new settings
+        IOProfile newProfile;
+        if (!newProfile.set(profileName, cacheBytes)) {
+            printf("ERROR: Unknown I/O profile %s (use default, core, lustre or paged).\n", profileName.c_str());
+            exit(EXIT_FAILURE);
+        }
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        ioProfile = newProfile;
+        usePageBuffer = true;
+        if (fileNames.size() > 0 && !reopenFiles()) {
+            GalacticusIngest_error("GalacticusReader: Error in opening files with new I/O profile.\n");
+        }
+    }
+
+    H5File* GalacticusReader::openH5File(const string name) {
+        // open a data file read-only with the settings of the I/O profile;
+        // files without paged file space cannot be opened with a page buffer
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+        H5File *newFp = NULL;
+
+        if (usePageBuffer && ioProfile.pageBufferBytes > 0) {
+            try {
+                newFp = new H5File((H5std_string) name, H5F_ACC_RDONLY, FileCreatPropList::DEFAULT, ioProfile.getFileAccess(true));
+            } catch (H5::Exception &e) {
+                cout << "WARNING: " << name << " has no paged file space, the page buffer is not used." << endl;
+                usePageBuffer = false;
+            }
+        }
+        if (!newFp) {
+            newFp = new H5File((H5std_string) name, H5F_ACC_RDONLY, FileCreatPropList::DEFAULT, ioProfile.getFileAccess(false));
+        }
+        ioProfile.adviseFile(newFp);
+
+        if (ioProfile.name.compare("default") != 0) {
+            boost::posix_time::ptime endTime = boost::posix_time::microsec_clock::universal_time();
+            printf("Time for opening %s with I/O profile %s: %lld ms\n", name.c_str(), ioProfile.describe().c_str(), (long long int) (endTime-startTime).total_milliseconds());
+            fflush(stdout);
+        }
+        return newFp;
+    }
+
+    DataSet GalacticusReader::openDataSetForReading(int f, const string s) {
+        // open a dataset for reading its values, with chunk cache and
+        // readahead hints of the I/O profile
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        if (ioProfile.chunkCacheBytes == 0) {
+            DataSet dataset = fps[f]->openDataSet(s);
+            ioProfile.adviseDataSet(fps[f], dataset);
+            return dataset;
+        }
+
+        // the cache is sized to hold the whole (uncompressed) dataset, if possible
+        DataSet probe = fps[f]->openDataSet(s);
+        long bytes = probe.getSpace().getSimpleExtentNpoints() * probe.getDataType().getSize();
+        probe.close();
+
+        DataSet dataset = fps[f]->openDataSet(s, ioProfile.getDataSetAccess(bytes));
+        ioProfile.adviseDataSet(fps[f], dataset);
+        return dataset;
+    }
+
+    void GalacticusReader::openFile(string newFileName) {
+        // open file as hdf5-file and append it to the files of this reader
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
 
         // TODO: catch error, if file does not exist or not accessible? before using H5 lib?
-        fp = new H5File(h5fileName, H5F_ACC_RDONLY); // allocates properly
+        H5File *newFp = openH5File(newFileName); // allocates properly
 
-        if (!fp) {
+        if (!newFp) {
             GalacticusIngest_error("GalacticusReader: Error in opening file.\n");
         }
 
+        fileNames.push_back(newFileName);
+        fps.push_back(newFp);
+        fp = fps[0];
     }
 
     void GalacticusReader::closeFile() {
-        if (fp) {
-            fp->close();
-            delete fp;
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        for (size_t f=0; f<fps.size(); f++) {
+            fps[f]->close();
+            delete fps[f];
         }
+        fps.clear();
+        fileNames.clear();
         fp = NULL;
     }
 
@@ -146,7 +540,17 @@ namespace Galacticus {
         return snapnum;
     }
 
+    vector<int> GalacticusReader::getSnapnums() {
+        // snapshot numbers of all outputs in the file(s)
+        vector<int> snapnums;
+        for (map<int, OutputMeta>::iterator it = outputMetaMap.begin(); it != outputMetaMap.end(); it++) {
+            snapnums.push_back(it->first);
+        }
+        return snapnums;
+    }
+
     void GalacticusReader::getOutputsMeta(long &numOutputs) {
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
         char line[1000];
         double aexp;
         int snapnum;
@@ -213,23 +617,90 @@ namespace Galacticus {
     }
 
     long GalacticusReader::getNumRowsInDataSet(string s) {
-        // get number of rows (data entries) in given dataset
+        // get number of rows (data entries) in given dataset, summed over all files;
         // just check with the one given dataset and assume that all datasets
         // have the same size!
         //sprintf(outputname, "Outputs/Output%d/nodeData", ioutput);
-        long nvalues;
+        vector<long> fileStart;
+        getFileRowStarts(s, fileStart);
+        return fileStart.back();
+    }
 
-        DataSet *d = new DataSet(fp->openDataSet(s));
-        DataSpace dataspace = d->getSpace();
+    string GalacticusReader::getOutputSignature(const string outputName) {
+        // names, extents and storage sizes of the output's datasets in each
+        // file: only metadata is read, and new outputs appended to a file
+        // do not change the signature of the existing ones
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        hsize_t dims_out[H5S_MAX_RANK];
+        stringstream ss;
+
+        for (size_t f=0; f<fps.size(); f++) {
+            ss << f << " " << fileNames[f].substr(fileNames[f].find_last_of('/') + 1) << endl;
+            if (!hasPath(fps[f], outputName)) {
+                continue;
+            }
+            vector<string> names;
+            Group group(fps[f]->openGroup(outputName));
+            H5Literate(group.getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, file_info, &names);
+            for (size_t k=0; k<names.size(); k++) {
+                DataSet d = group.openDataSet(names[k]);
+                DataSpace dataspace = d.getSpace();
+                int rank = dataspace.getSimpleExtentDims(dims_out, NULL);
+                ss << names[k];
+                for (int r=0; r<rank; r++) {
+                    ss << " " << dims_out[r];
+                }
+                ss << " " << d.getStorageSize() << endl;
+                d.close();
+            }
+            group.close();
+        }
+        return ss.str();
+    }
 
-        hsize_t dims_out[1];
-        int ndims = dataspace.getSimpleExtentDims(dims_out, NULL);
-        //cout << "dimension " << (unsigned long)(dims_out[0]) << endl;
-        nvalues = dims_out[0];
+    bool GalacticusReader::hasPath(H5File *file, const string s) {
+        // check each part of the path, H5Lexists fails for missing groups
+        string::size_type pos = 0;
+        while (pos != string::npos) {
+            pos = s.find('/', pos + 1);
+            if (H5Lexists(file->getId(), s.substr(0, pos).c_str(), H5P_DEFAULT) <= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-        delete d;
+    void GalacticusReader::getFileRowStarts(const string s, vector<long> &fileStart) {
+        // global number of the first row of the dataset in each file (plus the
+        // total number of rows at the end); a file may lack an output completely
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        hsize_t dims_out[H5S_MAX_RANK];
+
+        fileStart.assign(fps.size() + 1, 0);
+        for (size_t f=0; f<fps.size(); f++) {
+            fileStart[f+1] = fileStart[f];
+            if (!hasPath(fps[f], s)) {
+                continue;
+            }
+            DataSet d = fps[f]->openDataSet(s);
+            DataSpace dataspace = d.getSpace();
+            dataspace.getSimpleExtentDims(dims_out, NULL);
+            fileStart[f+1] += dims_out[0];
+            d.close();
+        }
+    }
 
-        return nvalues;
+    H5File* GalacticusReader::getFileWithDataSet(const string s) {
+        // first file that contains the given dataset or group
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        for (size_t f=0; f<fps.size(); f++) {
+            if (hasPath(fps[f], s)) {
+                return fps[f];
+            }
+        }
+        cout << "ERROR: " << s << " does not exist in any of the data files!" << endl;
+        abort();
+        return NULL;
     }
 
 
@@ -241,366 +712,1417 @@ namespace Galacticus {
     int GalacticusReader::getNextRow() {
         //assert(fileStream.is_open());
 
-        DataBlock b;
-        string name;
         string outputName;
 
+        // pause at the end of a segment (see setSegmentRows); the first
+        // call after startSegment continues with the next row
+        if (segmentRows > 0 && rowsInSegment >= segmentRows) {
+            return 0;
+        }
+
         // get one line from already read datasets (using readNextBlock)
-        // use readNextBlock to read the next block of datasets if necessary
-        if (currRow == 0) {
-            // we are at the very beginning
-            // read block for given snapnum or start reading from 1. block
+        // use readNextBlock to read the next block of datasets if necessary;
+        // if a filter is set, only the selected rows of each block are returned
+        if (blockLoaded) {
+            countSelected++;
+        }
 
-            if (user_snapnums.size() > 0) {
-                current_snapnum = user_snapnums[countSnap];
-                // check, if this snapnum really exists in outputMetaMap
+        while (!blockLoaded || countSelected >= numSelected) {
+            // end of data block/start of new one is reached (or we are at the very beginning)
+            // => read next datablocks (for next output number), skip blocks without selected rows
+            if (!nextOutput(outputName)) {
+                if (stats) {
+                    stats->writeReport();
+                }
+                if (asserter) {
+                    asserter->printReport();
+                }
+                if (aggregator) {
+                    aggregator->write();
+                }
+                if (checksums) {
+                    checksums->write();
+                }
+                finished = true;
+                return 0;
+            }
 
-                it_outputmap = outputMetaMap.find(current_snapnum);
-                while (it_outputmap == outputMetaMap.end() && countSnap < numOutputs) {
-                    cout << "Skipping snapnum " << current_snapnum << " because no corresponding output-group was found." << endl;
+            nvalues = readNextBlock(outputName);
+            blockLoaded = true;
+            countSelected = 0;
+        }
+
+        if (useSelection) {
+            countInBlock = selectedRows[countSelected];
+        } else {
+            countInBlock = countSelected;
+        }
+
+        currRow++; // counts all rows
+        rowsInSegment++;
+
+        // stop reading/ingesting, if mass is lower than threshold?
+        // stop after reading maxRows?
+
+        return 1;
+    }
+
+    int GalacticusReader::nextOutput(string &outputName) {
+        // advance to the next output that shall be read (i.e. the first one,
+        // if no block was loaded yet), return 0 if there is none left;
+        // outputs already ingested according to the manifest are skipped
+        bool advance = blockLoaded;
+        long rows;
+
+        if (blockLoaded && manifest && !blockFailed) {
+            manifest->addOutput(fileNum, current_snapnum, getOutputSignature(blockOutputName), numSelected);
+        }
+
+        while (true) {
+            if (user_snapnums.size() > 0) {
+                if (advance) {
                     countSnap++;
+                }
+                // check, if this snapnum really exists in outputMetaMap
+                // (in follow mode: wait for it to be written completely)
+                while (countSnap < (int) user_snapnums.size()) {
                     current_snapnum = user_snapnums[countSnap];
                     it_outputmap = outputMetaMap.find(current_snapnum);
+                    if (follow && !followDone && (it_outputmap == outputMetaMap.end() || isPendingOutput(it_outputmap))) {
+                        waitForOutputs();
+                        continue;
+                    }
+                    if (it_outputmap != outputMetaMap.end()) {
+                        break;
+                    }
+                    cout << "Skipping snapnum " << current_snapnum << " because no corresponding output-group was found." << endl;
+                    countSnap++;
                 }
-                if (it_outputmap == outputMetaMap.end()) {
+                if (countSnap >= (int) user_snapnums.size()) {
                     return 0;
                 }
-                outputName = (it_outputmap->second).outputName;
             } else {
+                if (advance && it_outputmap != outputMetaMap.end()) {
+                    it_outputmap++;
+                }
+                while (follow && !followDone && (it_outputmap == outputMetaMap.end() || isPendingOutput(it_outputmap))) {
+                    waitForOutputs();
+                    // continue after the last output (the map may have changed)
+                    if (advance) {
+                        it_outputmap = outputMetaMap.upper_bound(current_snapnum);
+                    } else {
+                        it_outputmap = outputMetaMap.begin();
+                    }
+                }
+                // check, if we haven't reached the end yet
+                if (it_outputmap == outputMetaMap.end()) {
+                    cout << "End of outputs group is reached." << endl;
+                    return 0;
+                }
                 current_snapnum = it_outputmap->first;
-                outputName = (it_outputmap->second).outputName;
             }
+            advance = true;
+
+            if (!manifest || !manifest->isComplete(fileNum, current_snapnum, getOutputSignature(it_outputmap->second.outputName), rows)) {
+                break;
+            }
+            cout << "Skipping snapnum " << current_snapnum << " because it was ingested already (" << rows << " rows)." << endl;
+        }
 
-            // get corresponding output name
-            //outputName = outputMetaMap[current_snapnum].outputName;
+        outputName = (it_outputmap->second).outputName;
+        return 1;
+    }
 
-            nvalues = readNextBlock(outputName);
-            countInBlock = 0;
-
-        } else if (countInBlock == nvalues-1) {
-            // end of data block/start of new one is reached!
-            // => read next datablocks (for next output number)
-            //cout << "Read next datablock!" << endl;
-
-            // check if we are at the end
-            //if (it_outputmap == outputMetaMap.end() || countSnap == user_snapnums.size()) {
-            //    return 0;
-            //}
-            if (countSnap == numOutputs-1) {
-                return 0;
+    bool GalacticusReader::isPendingOutput(map<int, OutputMeta>::iterator it) {
+        // the newest output may still be written to
+        it++;
+        return (it == outputMetaMap.end());
+    }
+
+    void GalacticusReader::waitForOutputs() {
+        // sleep, then open the files again and look for new outputs;
+        // the run is regarded as complete when the expected number of
+        // outputs exists or nothing new appeared for followTimeout seconds
+        long numBefore = outputMetaMap.size();
+        long numFound;
+
+        if (followOutputs > 0 && numBefore >= followOutputs) {
+            followDone = true;
+            return;
+        }
+
+        if (difftime(time(NULL), lastNewOutput) >= followTimeout) {
+            printf("No new outputs for %d seconds, regarding the run as complete.\n", followTimeout);
+            fflush(stdout);
+            followDone = true;
+            return;
+        }
+
+        printf("Waiting for new outputs (%ld found so far) ...\n", numBefore);
+        fflush(stdout);
+        boost::this_thread::sleep(boost::posix_time::seconds(pollInterval));
+
+        if (!reopenFiles()) {
+            return; // try again later
+        }
+        try {
+            getOutputsMeta(numFound);
+        } catch (H5::Exception &e) {
+            cout << "WARNING: Cannot read outputs meta data now, trying again later." << endl;
+            return;
+        }
+
+        if ((long) outputMetaMap.size() > numBefore) {
+            printf("Found %ld new outputs.\n", (long) outputMetaMap.size() - numBefore);
+            fflush(stdout);
+            lastNewOutput = time(NULL);
+        }
+        if (followOutputs > 0 && (long) outputMetaMap.size() >= followOutputs) {
+            followDone = true;
+        }
+    }
+
+    bool GalacticusReader::reopenFiles() {
+        // without SWMR, new groups are only visible after opening the files
+        // again; the old handles are kept, if this is not possible right now
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        vector<H5File*> newFps;
+        try {
+            for (size_t f=0; f<fileNames.size(); f++) {
+                newFps.push_back(openH5File(fileNames[f]));
+            }
+        } catch (H5::Exception &e) {
+            cout << "WARNING: Cannot open the data files now (still being written?), trying again later." << endl;
+            for (size_t f=0; f<newFps.size(); f++) {
+                newFps[f]->close();
+                delete newFps[f];
             }
+            return false;
+        }
 
-            // if we end up here, we should read the next block
-            if (user_snapnums.size() > 0) {
-                countSnap++;
-                current_snapnum = user_snapnums[countSnap];
-                // check, if this snapnum really exists in outputMetaMap
+        for (size_t f=0; f<fps.size(); f++) {
+            fps[f]->close();
+            delete fps[f];
+        }
+        fps.swap(newFps);
+        fp = fps[0];
+        return true;
+    }
 
-                it_outputmap = outputMetaMap.find(current_snapnum);
-                while (it_outputmap == outputMetaMap.end() && countSnap < numOutputs) {
-                    cout << "Skipping snapnum " << current_snapnum << " because no corresponding output-group was found." << endl;
-                    countSnap++;
-                    current_snapnum = user_snapnums[countSnap];
-                    it_outputmap = outputMetaMap.find(current_snapnum);
+    int GalacticusReader::readNextBlock(string outputName) {
+        // read one complete Output* block from Galacticus HDF5-file
+        // should fit into memory ... if not, need to adjust this
+        // and provide the number of values to be read each time
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+
+        //char outputname[1000];
+
+        //performance output stuff
+        boost::posix_time::ptime startTime;
+        boost::posix_time::ptime endTime;
+        string newtext = "";
+        boost::regex re(":z[0-9.]*");
+
+
+        startTime = boost::posix_time::microsec_clock::universal_time();
+        ioBytes = 0;
+
+        // first get names of all DataSets in nodeData group and their item size
+        //cout << "outputName: " << outputName<< endl;
+
+        Group group(getFileWithDataSet(outputName)->openGroup(outputName));
+        // maybe check here that it worked?
+
+        hsize_t len = group.getNumObjs();
+
+        //cout << "Iterating over Datasets in the group ... " << endl;
+        //H5L_iterate_t
+        //vector<string> dsnames;
+        dataSetNames.clear(); // actually, the names should be exactly the same as for the group before!! --> check this???
+        int idx2  = H5Literate(group.getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, file_info, &dataSetNames);
+
+        string s;
+        string dsname;
+        int numDataSets = dataSetNames.size();
+        //cout << "numDataSets: " << numDataSets << endl;
+
+        // remove redshifts from the dataset names (where necessary)
+        vector<string> matchNames;
+        map<string,int> matchNameMap;
+        for (int k=0; k<numDataSets; k++) {
+            dsname = dataSetNames[k];
+            // convert to matchname, i.e. remove possibly given redshift from the name:
+            string matchname = boost::regex_replace(dsname, re, newtext);
+            matchNames.push_back(matchname);
+            matchNameMap[matchname] = k;
+        }
+
+        // clear datablocks from previous block, before reading new ones;
+        // the key-value map for the dataset names is filled from scratch
+        // for each block while reading the datasets
+        for (size_t k=0; k<datablocks.size(); k++) {
+            datablocks[k].deleteData();
+        }
+        datablocks.clear();
+        dataSetMap.clear();
+        treeIndex.clear();
+        derivedColumns.clear();
+        vector<long>().swap(progenitorRow);
+        vector<long>().swap(descendantRow);
+        progenitorSnapnum = -1;
+        descendantSnapnum = -1;
+        blockOutputName = outputName;
+        blockMatchNames = matchNameMap;
+
+        //assume that nvalues is the same for each dataset (datablock) inside one Output-group (same redshift)
+        nvalues = 0;
+        if (numDataSets > 0) {
+            nvalues = getNumRowsInDataSet(string(outputName) + string("/") + dataSetNames[0]);
+        }
+        useSelection = false;
+        numSelected = nvalues;
+        blockFailed = false;
+
+        // with partitions, only a part of the rows is selected from the start;
+        // row numbers (and thus dbIds) stay the same as for the whole output
+        partStart = 0;
+        partEnd = nvalues;
+        if (numPartitions > 1) {
+            partStart = (nvalues * (partitionIndex - 1)) / numPartitions;
+            partEnd = (nvalues * partitionIndex) / numPartitions;
+            selectedRows.resize(partEnd - partStart);
+            for (long i=partStart; i<partEnd; i++) {
+                selectedRows[i - partStart] = i;
+            }
+            numSelected = selectedRows.size();
+            useSelection = true;
+        }
+
+        if (sampleFraction < 1) {
+            applySample();
+        }
+
+        if (rangeFilter) {
+            applyZoneMaps(outputName, matchNameMap);
+            applyFilter(rangeFilter, outputName, matchNameMap);
+        }
+        if (filter) {
+            applyFilter(filter, outputName, matchNameMap);
+        }
+        if (routeFilters.size() > 0) {
+            applyRoutes(outputName, matchNameMap);
+        }
+
+        // read each desired data set, use corresponding read routine for different types;
+        // with a selection only those chunks are read that contain selected rows
+        vector<RowRange> ranges;
+        for (int k=0; k<numDataSets; k++) {
+
+            if (dataSetMap.find(matchNames[k]) != dataSetMap.end()
+                || dataSetMap.find(matchNames[k] + string("[0]")) != dataSetMap.end()) {
+                continue; // already read for the filter
+            }
+            if (useSelection && numSelected == 0) {
+                break; // nothing to do for this block
+            }
+            if (projection.size() > 0 && projection.find(matchNames[k]) == projection.end()) {
+                continue;
+            }
+
+            s = string(outputName) + string("/") + dataSetNames[k];
+
+            if (useSelection) {
+                getSelectedChunks(s, ranges);
+                readDataSet(s, matchNames[k], &ranges);
+            } else {
+                readDataSet(s, matchNames[k], NULL);
+            }
+            //cout << nvalues << " values read." << endl;
+        }
+        // How to proceed from here onwards??
+        // Could read all data into data[0] to data[104] or so,
+        // but I need to keep the information which is which!
+        // Alternatively create one big structure to hold it all?
+
+        // => use a small class that contains
+        // 1) name of dataset
+        // 2) array of values, number of values
+        // use vector<newclass> to create a vector of these datasets.
+        // maybe can use datasets themselves, so no need to define own class?
+        // => assigning to the new class has already happened now inside the read-class.
+
+        if (asserter) {
+            applyAssertions(outputName);
+        }
+
+        if (sortKey != "") {
+            sortSelection();
+        }
+
+        if (aggregator) {
+            applyAggregates(outputName);
+        }
+
+        endTime = boost::posix_time::microsec_clock::universal_time();
+        if (useSelection) {
+            printf("Time for reading output %s (%ld rows, %ld selected): %lld ms\n", outputName.c_str(), nvalues, numSelected, (long long int) (endTime-startTime).total_milliseconds());
+        } else {
+            printf("Time for reading output %s (%ld rows): %lld ms\n", outputName.c_str(), nvalues, (long long int) (endTime-startTime).total_milliseconds());
+        }
+        if (ioProfile.name.compare("default") != 0) {
+            // ioBytes counts the decoded values, not the bytes read from the file
+            // (compression, whole chunks and sieve buffers are not included)
+            long ms = (endTime-startTime).total_milliseconds();
+            printf("I/O profile %s: %.1f MB of decoded values read from datasets, %.1f MB/s\n", ioProfile.name.c_str(), ioBytes / 1048576., (ms > 0) ? (ioBytes / 1048576.) / (ms / 1000.) : 0.);
+        }
+        fflush(stdout);
+
+        return nvalues;
+    }
+
+    void GalacticusReader::readDataSet(const string s, const string matchname, const vector<RowRange> *ranges) {
+        // read one dataset into a new datablock, check its type first;
+        // the datablock can then be found by its matchname in dataSetMap,
+        // components of 2-dimensional datasets by matchname[j]
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        long nvalues;
+        int first = datablocks.size();
+        int ncomponents = -1;
+
+        DataSet *dptr = new DataSet(getFileWithDataSet(s)->openDataSet(s));
+        H5T_class_t type_class = dptr->getTypeClass();
+        dptr->close();
+        delete dptr;
+
+        if (type_class == H5T_INTEGER) {
+            //cout << "DataSet has long type!" << endl;
+            ncomponents = readLongDataSet(s, nvalues, ranges);
+        } else if (type_class == H5T_FLOAT) {
+            //cout << "DataSet has double type!" << endl;
+            ncomponents = readDoubleDataSet(s, nvalues, ranges);
+        }
+
+        if (ncomponents == 0) {
+            replaceDataBlock(matchname, first);
+        }
+        for (int j=0; j<ncomponents; j++) {
+            stringstream ss;
+            ss << matchname << "[" << j << "]";
+            replaceDataBlock(ss.str(), first + j);
+        }
+    }
+
+    void GalacticusReader::replaceDataBlock(const string matchname, int k) {
+        // a column read again completely keeps the null flags that the
+        // assertions set for the selected rows of the partial read
+        map<string,int>::iterator it = dataSetMap.find(matchname);
+        if (it != dataSetMap.end() && datablocks[it->second].nulls && !datablocks[k].nulls) {
+            DataBlock &old = datablocks[it->second];
+            DataBlock &b = datablocks[k];
+            b.nulls = new char[b.nvalues];
+            memset(b.nulls, 0, b.nvalues);
+            for (long i=0; i<old.nvalues; i++) {
+                long row = old.first + i;
+                if (row >= b.first && row < b.first + b.nvalues) {
+                    b.nulls[row - b.first] = old.nulls[i];
                 }
-                if (it_outputmap == outputMetaMap.end()) {
-                    return 0;
+            }
+            delete[] old.nulls;
+            old.nulls = NULL;
+        }
+        dataSetMap[matchname] = k;
+    }
+
+    string GalacticusReader::getBaseName(const string column) {
+        // dataset name for a column, i.e. without component index
+        string::size_type pos = column.find('[');
+        if (pos == string::npos) {
+            return column;
+        }
+        return column.substr(0, pos);
+    }
+
+    void GalacticusReader::prepareFilter(RowFilter *f, const string outputName, map<string,int> &matchNameMap) {
+        // read the datasets needed for the filter (completely, or only the chunks
+        // with selected rows, if there is a selection already) and bind them
+        vector<string> filterColumns = f->getColumnNames();
+        vector<RowRange> ranges;
+        string s;
+
+        for (size_t i=0; i<filterColumns.size(); i++) {
+            map<string,int>::iterator it = matchNameMap.find(getBaseName(filterColumns[i]));
+            if (it == matchNameMap.end()) {
+                cout << "ERROR: Column " << filterColumns[i] << " used in filter does not exist in " << outputName << "!" << endl;
+                abort();
+            }
+            if (dataSetMap.find(filterColumns[i]) == dataSetMap.end()) {
+                s = string(outputName) + string("/") + dataSetNames[it->second];
+                if (useSelection) {
+                    getSelectedChunks(s, ranges);
+                    readDataSet(s, getBaseName(filterColumns[i]), &ranges);
+                } else {
+                    readDataSet(s, getBaseName(filterColumns[i]), NULL);
+                }
+                if (dataSetMap.find(filterColumns[i]) == dataSetMap.end()) {
+                    cout << "ERROR: Column " << filterColumns[i] << " used in filter does not exist in " << outputName << "!" << endl;
+                    abort();
+                }
+            }
+            DataBlock &b = datablocks[dataSetMap[filterColumns[i]]];
+            f->bindColumn(i, b.doubleval, b.longval, b.first);
+        }
+        f->setConstant("snapnum", current_snapnum);
+        f->setConstant("scale", outputMetaMap[current_snapnum].outputExpansionFactor);
+    }
+
+    void GalacticusReader::applyFilter(RowFilter *f, const string outputName, map<string,int> &matchNameMap) {
+        // evaluate the filter; the selection is narrowed down accordingly
+        prepareFilter(f, outputName, matchNameMap);
+
+        if (useSelection) {
+            vector<long> candidates;
+            candidates.swap(selectedRows);
+            numSelected = f->evaluate(candidates, selectedRows);
+        } else {
+            numSelected = f->evaluate(nvalues, selectedRows);
+        }
+        useSelection = true;
+    }
+
+    void GalacticusReader::applyRoutes(const string outputName, map<string,int> &matchNameMap) {
+        // mark the (selected) rows that fulfill the condition of each route,
+        // bit r of the mask stands for route r
+        vector<long> candidates;
+        vector<long> matching;
+
+        routeMasks.assign(nvalues, 0);
+        if (useSelection) {
+            candidates = selectedRows;
+        } else {
+            candidates.resize(nvalues);
+            for (long i=0; i<nvalues; i++) {
+                candidates[i] = i;
+            }
+        }
+
+        for (size_t r=0; r<routeFilters.size(); r++) {
+            prepareFilter(routeFilters[r], outputName, matchNameMap);
+            routeFilters[r]->evaluate(candidates, matching);
+            for (size_t i=0; i<matching.size(); i++) {
+                routeMasks[matching[i]] |= (1UL << r);
+            }
+        }
+    }
+
+    static unsigned long sampleHash(long dbId, unsigned long seed) {
+        // mix the bits, dbIds of one output are consecutive numbers
+        unsigned long h = (unsigned long) dbId + seed * 0x9e3779b97f4a7c15UL;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdUL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53UL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    void GalacticusReader::applySample() {
+        // select the rows whose dbId hash is below the fraction; this only
+        // depends on the dbId, so the sample is the same in each run (and
+        // also for a partition or a filter applied later)
+        long dbIdStart = (fileNum * snapnumfactor + current_snapnum) * rowfactor;
+        double limit = sampleFraction * 18446744073709551616.; // 2^64
+        vector<long> candidates;
+        long row;
+        long n;
+
+        if (useSelection) {
+            candidates.swap(selectedRows);
+            n = candidates.size();
+        } else {
+            n = nvalues;
+        }
+
+        selectedRows.clear();
+        for (long i=0; i<n; i++) {
+            row = useSelection ? candidates[i] : i;
+            if ((double) sampleHash(dbIdStart + row, sampleSeed) < limit) {
+                selectedRows.push_back(row);
+            }
+        }
+        numSelected = selectedRows.size();
+        useSelection = true;
+    }
+
+    void GalacticusReader::applyAssertions(const string outputName) {
+        // check the assertions column by column for the (selected) rows, on
+        // the values as they are in the file (before unit conversion)
+        vector<long> rows;
+        vector<char> drop;
+        long violations;
+        long total = 0;
+        long dropped = 0;
+        bool failed = false;
+
+        if (useSelection) {
+            rows = selectedRows;
+        } else {
+            rows.resize(nvalues);
+            for (long i=0; i<nvalues; i++) {
+                rows[i] = i;
+            }
+        }
+        if (rows.size() == 0) {
+            return;
+        }
+        drop.assign(nvalues, 0);
+
+        for (int i=0; i<asserter->getNumAssertions(); i++) {
+            ColumnAssertion &a = asserter->getAssertion(i);
+            map<string,int>::iterator it = dataSetMap.find(a.column);
+            if (it == dataSetMap.end()) {
+                cout << "ERROR: Column " << a.column << " used in assertion does not exist in " << outputName << "!" << endl;
+                abort();
+            }
+            DataBlock &b = datablocks[it->second];
+            if ((a.action == ACTION_NULL || a.action == ACTION_CLAMP) && !b.nulls) {
+                b.nulls = new char[b.nvalues];
+                memset(b.nulls, 0, b.nvalues);
+            }
+
+            violations = asserter->check(i, current_snapnum, b.doubleval, b.longval, b.first, rows, b.nulls, drop);
+            total += violations;
+            if (violations > 0 && a.action == ACTION_FAIL) {
+                printf("ERROR: Assertion %s for column %s failed for %ld rows in output %s, skipping this output.\n", a.spec.c_str(), a.column.c_str(), violations, outputName.c_str());
+                failed = true;
+            }
+        }
+
+        if (failed) {
+            asserter->addFailedOutput(current_snapnum);
+            selectedRows.clear();
+            numSelected = 0;
+            useSelection = true;
+            blockFailed = true;
+        } else {
+            selectedRows.clear();
+            for (size_t i=0; i<rows.size(); i++) {
+                if (drop[rows[i]]) {
+                    dropped++;
+                } else {
+                    selectedRows.push_back(rows[i]);
+                }
+            }
+            numSelected = selectedRows.size();
+            useSelection = true;
+        }
+
+        if (total > 0) {
+            printf("Assertions for output %s: %ld violations, %ld rows dropped\n", outputName.c_str(), total, dropped);
+        }
+    }
+
+    void GalacticusReader::applyAggregates(const string outputName) {
+        // aggregate the rows that are ingested from this output; the values
+        // of each column are converted once into an array (as for the database)
+        map<string, vector<double> > columnValues;
+        vector<long> rows;
+        long n = useSelection ? numSelected : nvalues;
+
+        if (useSelection) {
+            rows = selectedRows;
+        } else {
+            rows.resize(nvalues);
+            for (long i=0; i<nvalues; i++) {
+                rows[i] = i;
+            }
+        }
+
+        for (int i=0; i<aggregator->getNumAggregates(); i++) {
+            vector<string> columns = aggregator->getColumns(i);
+            vector<const double*> values;
+            for (size_t c=0; c<columns.size(); c++) {
+                if (columnValues.find(columns[c]) == columnValues.end()) {
+                    getAggregateValues(columns[c], rows, columnValues[columns[c]]);
+                }
+                values.push_back((n > 0) ? &columnValues[columns[c]][0] : NULL);
+            }
+            aggregator->addOutput(i, current_snapnum, n, values);
+        }
+    }
+
+    void GalacticusReader::getAggregateValues(const string column, const vector<long> &rows, vector<double> &values) {
+        // values of the given rows in database units, NaN for NULL values;
+        // the unit conversion is a factor for each column and output
+        map<string,int>::iterator it = dataSetMap.find(column);
+        if (it == dataSetMap.end()) {
+            cout << "ERROR: Column " << column << " used in aggregate does not exist in " << blockOutputName << "!" << endl;
+            abort();
+        }
+        DataBlock &b = datablocks[it->second];
+        double factor = b.converted ? 1. : convertUnits(column, 1., outputMetaMap[current_snapnum].outputExpansionFactor);
+        double nan = numeric_limits<double>::quiet_NaN();
+        long n = rows.size();
+
+        values.resize(n);
+        if (b.longval) {
+            for (long i=0; i<n; i++) {
+                values[i] = (double) b.longval[rows[i] - b.first];
+            }
+        } else {
+            for (long i=0; i<n; i++) {
+                values[i] = b.doubleval[rows[i] - b.first] * factor;
+            }
+        }
+        if (b.nulls) {
+            for (long i=0; i<n; i++) {
+                if (b.nulls[rows[i] - b.first]) {
+                    values[i] = nan;
+                }
+            }
+        }
+    }
+
+    void GalacticusReader::sortSelection() {
+        // return the rows of this output ordered by the sort key: the row
+        // numbers of the selection (or of all rows) are sorted, the data
+        // itself stays where it is
+        vector<unsigned long> keys;
+        vector<long> rows;
+
+        if (useSelection) {
+            rows.swap(selectedRows);
+        } else {
+            rows.resize(nvalues);
+            for (long i=0; i<nvalues; i++) {
+                rows[i] = i;
+            }
+        }
+        keys.resize(rows.size());
+
+        if (sortKey.compare("depthFirstId") == 0) {
+            if (!treeIndex.isBuilt() && !buildTreeIndex()) {
+                cout << "ERROR: Sorting by depthFirstId needs nodeIndex and parentIndex in " << blockOutputName << "!" << endl;
+                abort();
+            }
+            for (size_t i=0; i<rows.size(); i++) {
+                keys[i] = getSortableKey(treeIndex.getDepthFirstId(rows[i]));
+            }
+        } else {
+            map<string,int>::iterator it = dataSetMap.find(sortKey);
+            if (it == dataSetMap.end()) {
+                cout << "ERROR: Column " << sortKey << " used for sorting does not exist in " << blockOutputName << "!" << endl;
+                abort();
+            }
+            DataBlock &b = datablocks[it->second];
+            if (b.longval) {
+                for (size_t i=0; i<rows.size(); i++) {
+                    keys[i] = getSortableKey(b.longval[rows[i] - b.first]);
                 }
-                outputName = (it_outputmap->second).outputName;
             } else {
-                it_outputmap++;
+                for (size_t i=0; i<rows.size(); i++) {
+                    keys[i] = getSortableKey(b.doubleval[rows[i] - b.first]);
+                }
+            }
+        }
 
-                // check, if we haven't reached the end yet
-                if (it_outputmap == outputMetaMap.end()) {
-                    cout << "End of outputs group is reached." << endl;
-                    return 0;
+        radixSortRows(keys, rows, sortThreads);
+
+        selectedRows.swap(rows);
+        numSelected = selectedRows.size();
+        useSelection = true;
+    }
+
+    void GalacticusReader::applyZoneMaps(const string outputName, map<string,int> &matchNameMap) {
+        // select all rows of those chunks that may contain values inside the
+        // requested ranges; zone maps that do not exist yet are computed
+        // here (and then saved for the next run)
+        vector<RowRange> candidates;
+        vector<RowRange> matching;
+        vector<RowRange> merged;
+        string s;
+        long end;
+
+        candidates.push_back(RowRange(partStart, partEnd - partStart));
+
+        for (size_t i=0; i<rangeColumns.size(); i++) {
+            map<string,int>::iterator it = matchNameMap.find(getBaseName(rangeColumns[i]));
+            if (it == matchNameMap.end()) {
+                cout << "ERROR: Column " << rangeColumns[i] << " used in range does not exist in " << outputName << "!" << endl;
+                abort();
+            }
+
+            if (!zoneMap->hasColumn(outputName, rangeColumns[i]) || zoneMap->getColumn(outputName, rangeColumns[i]).nvalues != nvalues) {
+                s = string(outputName) + string("/") + dataSetNames[it->second];
+                DataBlock b = getCompleteColumn(rangeColumns[i]);
+                zoneMap->computeColumn(outputName, rangeColumns[i], b.doubleval, b.longval, nvalues, getChunkSize(s));
+            }
+
+            // collect matching chunks
+            ZoneMapColumn &z = zoneMap->getColumn(outputName, rangeColumns[i]);
+            matching.clear();
+            for (long c=0; c<(long) z.minval.size(); c++) {
+                if (z.maxval[c] >= rangeMin[i] && z.minval[c] <= rangeMax[i]) {
+                    end = (c+1) * z.chunksize;
+                    if (end > nvalues) {
+                        end = nvalues;
+                    }
+                    if (matching.size() > 0 && matching.back().start + matching.back().count == c * z.chunksize) {
+                        matching.back().count = end - matching.back().start;
+                    } else {
+                        matching.push_back(RowRange(c * z.chunksize, end - c * z.chunksize));
+                    }
                 }
+            }
 
-                current_snapnum = it_outputmap->first;
-                outputName = (it_outputmap->second).outputName;
+            // intersect with the candidates so far
+            merged.clear();
+            size_t j = 0;
+            size_t k = 0;
+            while (j < candidates.size() && k < matching.size()) {
+                long start1 = candidates[j].start;
+                long end1 = start1 + candidates[j].count;
+                long start2 = matching[k].start;
+                long end2 = start2 + matching[k].count;
+                long start = (start1 > start2) ? start1 : start2;
+                end = (end1 < end2) ? end1 : end2;
+                if (start < end) {
+                    merged.push_back(RowRange(start, end - start));
+                }
+                if (end1 < end2) {
+                    j++;
+                } else {
+                    k++;
+                }
             }
+            candidates.swap(merged);
+        }
+        zoneMap->save();
+
+        // all rows of the candidate chunks are selected for now (or, with a
+        // selection already, e.g. a sample, those of its rows inside them);
+        // the exact check is done by the range filter
+        vector<long> previous;
+        if (useSelection) {
+            previous.swap(selectedRows);
+        }
+        selectedRows.clear();
+        long p = 0;
+        for (size_t j=0; j<candidates.size(); j++) {
+            end = candidates[j].start + candidates[j].count;
+            if (useSelection) {
+                while (p < (long) previous.size() && previous[p] < candidates[j].start) {
+                    p++;
+                }
+                while (p < (long) previous.size() && previous[p] < end) {
+                    selectedRows.push_back(previous[p++]);
+                }
+            } else {
+                for (long i=candidates[j].start; i<end; i++) {
+                    selectedRows.push_back(i);
+                }
+            }
+        }
+        numSelected = selectedRows.size();
+        useSelection = true;
+    }
+
+    DataBlock GalacticusReader::getCompleteColumn(const string matchname) {
+        // datablock with the values of a column for all rows of the current output;
+        // a column that was read only for the selected chunks is read again
+        map<string,int>::iterator it = dataSetMap.find(matchname);
+        if (it == dataSetMap.end() || !datablocks[it->second].complete) {
+            map<string,int>::iterator itname = blockMatchNames.find(getBaseName(matchname));
+            if (itname == blockMatchNames.end()) {
+                cout << "ERROR: Column " << matchname << " does not exist in " << blockOutputName << "!" << endl;
+                abort();
+            }
+            readDataSet(blockOutputName + string("/") + dataSetNames[itname->second], getBaseName(matchname), NULL);
+            it = dataSetMap.find(matchname);
+        }
+        if (it == dataSetMap.end()) {
+            cout << "ERROR: Column " << matchname << " does not exist in " << blockOutputName << "!" << endl;
+            abort();
+        }
+        return datablocks[it->second];
+    }
+
+    long* GalacticusReader::getCompleteLongColumn(const string matchname) {
+        DataBlock b = getCompleteColumn(matchname);
+        if (!b.longval) {
+            cout << "ERROR: Column " << matchname << " has no integer type in " << blockOutputName << "!" << endl;
+            abort();
+        }
+        return b.longval;
+    }
 
-            // get corresponding output name -- already done
-            // outputName = outputMetaMap[current_snapnum].outputName;
+    void GalacticusReader::buildNodeHash() {
+        // row lookup by nodeIndex, shared with the tree index
+        if (treeIndex.nodeHash.isEmpty()) {
+            treeIndex.nodeHash.build(getCompleteLongColumn("nodeIndex"), nvalues);
+        }
+    }
 
-            nvalues = readNextBlock(outputName);
-            countInBlock = 0;
+    DerivedColumn & GalacticusReader::getDerivedColumn(const string name) {
+        // gather the values of the source column from the referenced rows,
+        // for all rows of the output at once; name is source@reference,
+        // e.g. basicMass@parentIndex or positionPositionX@satelliteNodeIndex
+        map<string, DerivedColumn>::iterator it = derivedColumns.find(name);
+        if (it != derivedColumns.end()) {
+            return it->second;
+        }
 
+        string::size_type pos = name.find('@');
+        string sourceName = name.substr(0, pos);
+        string refName = name.substr(pos + 1);
+        long row;
+
+        buildNodeHash();
+        long *ref = getCompleteLongColumn(refName);
+        DataBlock src = getCompleteColumn(sourceName);
+
+        DerivedColumn &d = derivedColumns[name];
+        d.sourceName = sourceName;
+        d.converted = src.converted;
+        d.isNull.resize(nvalues);
+        if (src.doubleval) {
+            d.doubleval.resize(nvalues);
         } else {
-            countInBlock++;
+            d.longval.resize(nvalues);
         }
 
-        currRow++; // counts all rows
-
-        // stop reading/ingesting, if mass is lower than threshold?
-        // stop after reading maxRows?
+        for (long i=0; i<nvalues; i++) {
+            row = (ref[i] < 0) ? -1 : treeIndex.nodeHash.find(ref[i]);
+            d.isNull[i] = (row < 0);
+            if (row < 0) {
+                row = i; // any valid value, it is NULL anyway
+            } else if (src.nulls) {
+                d.isNull[i] = src.nulls[row];
+            }
+            if (src.doubleval) {
+                d.doubleval[i] = src.doubleval[row];
+            } else {
+                d.longval[i] = src.longval[row];
+            }
+        }
 
-        return 1;
+        return d;
     }
 
-    int GalacticusReader::readNextBlock(string outputName) {
-        // read one complete Output* block from Galacticus HDF5-file
-        // should fit into memory ... if not, need to adjust this
-        // and provide the number of values to be read each time
-
-        long nvalues;
-        //char outputname[1000];
+    bool GalacticusReader::hasColumn(const string matchname) {
+        // column was read or can be read for the current output
+        return (dataSetMap.find(matchname) != dataSetMap.end()
+                || blockMatchNames.find(getBaseName(matchname)) != blockMatchNames.end());
+    }
 
-        //performance output stuff
+    bool GalacticusReader::buildTreeIndex() {
+        // forests need all nodes of the output, also the ones not selected;
+        // returns false if the output has no tree information
         boost::posix_time::ptime startTime;
         boost::posix_time::ptime endTime;
-        string newtext = "";
-        boost::regex re(":z[0-9.]*");
 
+        if (!hasColumn("nodeIndex") || !hasColumn("parentIndex")) {
+            if (!treeColumnsWarned) {
+                cout << "WARNING: No nodeIndex or parentIndex in " << blockOutputName << ", forestId and depthFirstId will be NULL." << endl;
+                treeColumnsWarned = true;
+            }
+            return false;
+        }
 
         startTime = boost::posix_time::microsec_clock::universal_time();
 
-        // first get names of all DataSets in nodeData group and their item size
-        //cout << "outputName: " << outputName<< endl;
-
-        Group group(fp->openGroup(outputName));
-        // maybe check here that it worked?
-
-        hsize_t len = group.getNumObjs();
+        long *nodeIndex = getCompleteLongColumn("nodeIndex");
+        long *parentIndex = getCompleteLongColumn("parentIndex");
+        treeIndex.build(nodeIndex, parentIndex, nvalues);
 
-        //cout << "Iterating over Datasets in the group ... " << endl;
-        //H5L_iterate_t
-        //vector<string> dsnames;
-        dataSetNames.clear(); // actually, the names should be exactly the same as for the group before!! --> check this???
-        int idx2  = H5Literate(group.getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, file_info, &dataSetNames);
+        endTime = boost::posix_time::microsec_clock::universal_time();
+        printf("Time for building tree index for %s (%ld nodes): %lld ms\n", blockOutputName.c_str(), nvalues, (long long int) (endTime-startTime).total_milliseconds());
+        fflush(stdout);
+        return true;
+    }
 
+    int GalacticusReader::buildLinks(vector<long> &linkRow, int direction) {
+        // find the rows of the current output's nodes in the next (direction = 1)
+        // or previous (direction = -1) output of the file by matching nodeIndex:
+        // the other output is streamed in slices and probed against the hash
+        // index of the current one, so only one slice is in memory at a time;
+        // returns the other output's snapnum or -2, if there is none
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        map<int, OutputMeta>::iterator it = outputMetaMap.find(current_snapnum);
+        long *buffer;
+        long row;
+        long count;
+        long nother;
+        long nfile;
+        vector<long> fileStart;
         string s;
-        string dsname;
-        string matchname;
-        int numDataSets = dataSetNames.size();
-        //cout << "numDataSets: " << numDataSets << endl;
+        boost::posix_time::ptime startTime;
+        boost::posix_time::ptime endTime;
 
-        // create a key-value map for the dataset names, do it from scratch for each block,
-        // and remove redshifts from the dataset names (where necessary)
-        dataSetMap.clear();
-        for (int k=0; k<numDataSets; k++) {
-            dsname = dataSetNames[k];
-            // convert to matchname, i.e. remove possibly given redshift from the name:
-            string matchname = boost::regex_replace(dsname, re, newtext);
-            dataSetMap[matchname] = k;
-            //dataSetMatchNames.push_back(matchname);
+        linkRow.assign(nvalues, -1);
+
+        if (direction > 0) {
+            it++;
+            if (it == outputMetaMap.end()) {
+                return -2;
+            }
+        } else {
+            if (it == outputMetaMap.begin()) {
+                return -2;
+            }
+            it--;
         }
 
-        // clear datablocks from previous block, before reading new ones:
-        datablocks.clear();
+        startTime = boost::posix_time::microsec_clock::universal_time();
+        buildNodeHash();
 
-        // read each desired data set, use corresponding read routine for different types
-        for (int k=0; k<numDataSets; k++) {
+        s = it->second.outputName + string("/nodeIndex");
+        getFileRowStarts(s, fileStart);
+        nother = fileStart.back();
 
-            dsname = dataSetNames[k];
-            s = string(outputName) + string("/") + dsname;
+        buffer = new long[linkChunkRows];
 
-            DataSet *dptr = new DataSet(fp->openDataSet(s));
-            DataSet dataset = *dptr; // for convenience
+        for (size_t f=0; f<fps.size(); f++) {
+            nfile = fileStart[f+1] - fileStart[f];
+            if (nfile == 0) {
+                continue;
+            }
+            DataSet dataset = fps[f]->openDataSet(s);
+            DataSpace dataspace = dataset.getSpace();
 
-            // check class type
-            H5T_class_t type_class = dataset.getTypeClass();
-            if (type_class == H5T_INTEGER) {
-                //cout << "DataSet has long type!" << endl;
-                long *data = readLongDataSet(s, nvalues);
-            } else if (type_class == H5T_FLOAT) {
-                //cout << "DataSet has double type!" << endl;
-                double *data2 = readDoubleDataSet(s, nvalues);
+            for (long start=0; start<nfile; start+=linkChunkRows) {
+                count = nfile - start;
+                if (count > linkChunkRows) {
+                    count = linkChunkRows;
+                }
+                hsize_t offset[1];
+                hsize_t dims[1];
+                offset[0] = start;
+                dims[0] = count;
+                DataSpace memspace(1, dims);
+                dataspace.selectHyperslab(H5S_SELECT_SET, dims, offset);
+                dataset.read(buffer, PredType::NATIVE_LONG, memspace, dataspace);
+
+                for (long j=0; j<count; j++) {
+                    row = treeIndex.nodeHash.find(buffer[j]);
+                    if (row >= 0 && linkRow[row] < 0) {
+                        linkRow[row] = fileStart[f] + start + j;
+                    }
+                }
             }
-            //cout << nvalues << " values read." << endl;
+
+            dataset.close();
         }
-        // How to proceed from here onwards??
-        // Could read all data into data[0] to data[104] or so,
-        // but I need to keep the information which is which!
-        // Alternatively create one big structure to hold it all?
 
-        // => use a small class that contains
-        // 1) name of dataset
-        // 2) array of values, number of values
-        // use vector<newclass> to create a vector of these datasets.
-        // maybe can use datasets themselves, so no need to define own class?
-        // => assigning to the new class has already happened now inside the read-class.
+        delete[] buffer;
 
         endTime = boost::posix_time::microsec_clock::universal_time();
-        printf("Time for reading output %s (%ld rows): %lld ms\n", outputName.c_str(), nvalues, (long long int) (endTime-startTime).total_milliseconds());
+        printf("Time for linking %s with %s (%ld nodes): %lld ms\n", blockOutputName.c_str(), it->second.outputName.c_str(), nother, (long long int) (endTime-startTime).total_milliseconds());
         fflush(stdout);
 
-        return nvalues; //assume that nvalues is the same for each dataset (datablock) inside one Output-group (same redshift)
+        return it->first;
     }
 
+    long GalacticusReader::getChunkSize(const string s) {
+        // chunk size of the dataset, or the default size for partial reads,
+        // if the dataset is not chunked
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        long chunksize = selectChunkSize;
+
+        DataSet *dptr = new DataSet(getFileWithDataSet(s)->openDataSet(s));
+        DSetCreatPropList plist = dptr->getCreatePlist();
+        if (plist.getLayout() == H5D_CHUNKED) {
+            hsize_t chunkdims[2];
+            plist.getChunk(2, chunkdims);
+            chunksize = chunkdims[0];
+        }
+        plist.close();
+        dptr->close();
+        delete dptr;
 
-    long* GalacticusReader::readLongDataSet(const std::string s, long &nvalues) {
-        // read a long-type dataset
-        //std::string s2("Outputs/Output79/nodeData/blackHoleCount");
-        // DataSet dataset = fp->openDataSet(s);
-        // rather need pointer to dataset in order to delete it later on:
+        return chunksize;
+    }
 
-        //cout << "Reading DataSet '" << s << "'" << endl;
+    bool GalacticusReader::isChunked(const string s) {
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        DataSet dataset = getFileWithDataSet(s)->openDataSet(s);
+        DSetCreatPropList plist = dataset.getCreatePlist();
+        bool chunked = (plist.getLayout() == H5D_CHUNKED);
+        plist.close();
+        dataset.close();
+        return chunked;
+    }
 
-        DataSet *dptr = new DataSet(fp->openDataSet(s)); // need pointer because of "new ..."
-        DataSet dataset = *dptr; // for convenience
+    void GalacticusReader::getSelectedChunks(const string s, vector<RowRange> &ranges) {
+        // get the row ranges of all chunks of the dataset that contain
+        // at least one selected row; neighbouring chunks are merged, and
+        // with partitions, the rows of the other partitions are left out
+        long chunksize = getChunkSize(s);
+        long chunkstart;
+        long end;
+
+        ranges.clear();
+
+        // sparse selections (e.g. small samples) of contiguous datasets: if the
+        // selected rows are further apart than the sieve buffer, which HDF5
+        // reads at once, only the selected rows themselves are read
+        long sieveRows = ((ioProfile.sieveBytes > 0) ? ioProfile.sieveBytes : DEFAULT_SIEVE_BYTES) / sizeof(double);
+        if (numSelected * sieveRows < nvalues && !isChunked(s)) {
+            for (long i=0; i<numSelected; i++) {
+                if (ranges.size() > 0 && ranges.back().start + ranges.back().count == selectedRows[i]) {
+                    ranges.back().count++;
+                } else {
+                    ranges.push_back(RowRange(selectedRows[i], 1));
+                }
+            }
+            return;
+        }
 
-        // check class type
-        H5T_class_t type_class = dataset.getTypeClass();
-        if (type_class != H5T_INTEGER) {
-            cout << "Data does not have long type!" << endl;
-            abort();
+        for (long i=0; i<numSelected; i++) {
+            chunkstart = (selectedRows[i] / chunksize) * chunksize;
+            end = chunkstart + chunksize;
+            if (chunkstart < partStart) {
+                chunkstart = partStart;
+            }
+            if (end > partEnd) {
+                end = partEnd;
+            }
+            if (ranges.size() > 0 && ranges.back().start + ranges.back().count >= chunkstart) {
+                ranges.back().count = end - ranges.back().start;
+            } else {
+                ranges.push_back(RowRange(chunkstart, end - chunkstart));
+            }
         }
-        // check byte order
-        IntType intype = dataset.getIntType();
-        H5std_string order_string;
-        H5T_order_t order = intype.getOrder(order_string);
-        //cout << order_string << endl;
+    }
 
-        // check again data sizes
-        if (sizeof(long) != intype.getSize()) {
-            cout << "Mismatch of long data type." << endl;
-            abort();
+    static long getNumRowsInRanges(const vector<RowRange> *ranges, long nvalues) {
+        // number of rows that are read with the given ranges (all without ranges)
+        if (!ranges) {
+            return nvalues;
+        }
+        long n = 0;
+        for (size_t r=0; r<ranges->size(); r++) {
+            n += (*ranges)[r].count;
         }
+        return n;
+    }
 
-        size_t dsize = intype.getSize();
-        //cout << "Data size is " << dsize << endl;
+    static void getRangesSpan(const vector<RowRange> *ranges, long nvalues, long &first, long &count) {
+        // rows first ... first+count-1 of the output contain all given ranges
+        // (all rows without ranges), only these are kept in memory
+        if (!ranges) {
+            first = 0;
+            count = nvalues;
+            return;
+        }
+        long last = 0;
+        first = (ranges->size() > 0) ? (*ranges)[0].start : 0;
+        for (size_t r=0; r<ranges->size(); r++) {
+            if ((*ranges)[r].start < first) {
+                first = (*ranges)[r].start;
+            }
+            if ((*ranges)[r].start + (*ranges)[r].count > last) {
+                last = (*ranges)[r].start + (*ranges)[r].count;
+            }
+        }
+        count = (last > first) ? last - first : 0;
+    }
 
-        // get dataspace of the dataset (the array length or so)
+    static void readFileRows(DataSet &dataset, void *buffer, const PredType &memtype, long bufferStart, long bufferRows, long fileStart, const vector<RowRange> *ranges, int component) {
+        // read the rows of one file into their positions in the buffer, which
+        // holds the rows from bufferStart on (the file's rows start at
+        // fileStart): the union of all given row ranges
+        // inside this file, or all of its rows, if there are no ranges;
+        // for a 2-dimensional dataset only the given component of each row is read
         DataSpace dataspace = dataset.getSpace();
-        ////hid_t dataspace = H5Dget_space(dataset); --> this does not work!! At least not with dataset defined as above!
-
-        // get number of dimensions in dataspace
-        int rank = dataspace.getSimpleExtentNdims();
-        //cout << "Dataspace rank is " << rank << endl;
-        // I expect this to be 1 for all Galacticus datasets!
-        // There are no 2 (or more) dimensional arrays stored in one dataset, are there?
-        if (rank > 1) {
-            cout << "ERROR: Cannot cope with multi-dimensional datasets!" << endl;
-            abort();
+        hsize_t dims_out[2];
+        dataspace.getSimpleExtentDims(dims_out, NULL);
+        long fileEnd = fileStart + dims_out[0];
+
+        hsize_t memdims[1];
+        memdims[0] = (bufferRows > 0) ? bufferRows : 1;
+        DataSpace memspace(1, memdims);
+
+        hsize_t start[2];
+        hsize_t memstart[1];
+        hsize_t count[2];
+        long first;
+        long last;
+        long nselected = 0;
+
+        // many short ranges (sparse selections): a point selection
+        // is much faster to build than the union of the hyperslabs
+        if (ranges && ranges->size() > 64 && getNumRowsInRanges(ranges, 0) < 4 * (long) ranges->size()) {
+            int rank = dataspace.getSimpleExtentNdims();
+            vector<hsize_t> coords;
+            vector<hsize_t> memcoords;
+            for (size_t i=0; i<ranges->size(); i++) {
+                for (long row=(*ranges)[i].start; row<(*ranges)[i].start + (*ranges)[i].count; row++) {
+                    if (row < fileStart || row >= fileEnd) {
+                        continue;
+                    }
+                    coords.push_back(row - fileStart);
+                    if (rank == 2) {
+                        coords.push_back(component);
+                    }
+                    memcoords.push_back(row - bufferStart);
+                }
+            }
+            if (memcoords.size() > 0) {
+                dataspace.selectElements(H5S_SELECT_SET, memcoords.size(), &coords[0]);
+                memspace.selectElements(H5S_SELECT_SET, memcoords.size(), &memcoords[0]);
+                dataset.read(buffer, memtype, memspace, dataspace);
+            }
+            return;
+        }
+
+        start[1] = component;
+        count[1] = 1;
+        dataspace.selectNone();
+        memspace.selectNone();
+        for (size_t i=0; i<(ranges ? ranges->size() : 1); i++) {
+            first = ranges ? (*ranges)[i].start : fileStart;
+            last = ranges ? first + (*ranges)[i].count : fileEnd;
+            if (first < fileStart) {
+                first = fileStart;
+            }
+            if (last > fileEnd) {
+                last = fileEnd;
+            }
+            if (first >= last) {
+                continue;
+            }
+            start[0] = first - fileStart;
+            memstart[0] = first - bufferStart;
+            count[0] = last - first;
+            dataspace.selectHyperslab(H5S_SELECT_OR, count, start);
+            memspace.selectHyperslab(H5S_SELECT_OR, count, memstart);
+            nselected += count[0];
         }
 
-        hsize_t dims_out[1];
-        int ndims = dataspace.getSimpleExtentDims(dims_out, NULL);
-        //cout << "dimension " << (unsigned long)(dims_out[0]) << endl;
-        nvalues = dims_out[0];
+        if (nselected > 0) {
+            dataset.read(buffer, memtype, memspace, dataspace);
+        }
+    }
 
-        // alternative way of determining data size (needed for buffer memory allocation!)
-        //size_t size = dataset.getInMemDataSize();
-        //cout << size << endl;
-        //int nvalues = size/sizeof(long);
+    int GalacticusReader::readLongDataSet(const std::string s, long &nvalues, const vector<RowRange> *ranges) {
+        // read a long-type dataset; 2-dimensional datasets (e.g. N x 3 vectors)
+        // are split into one datablock per component, the number of
+        // components is returned then (0 for 1-dimensional datasets);
+        // with several files, their rows are concatenated
+        //std::string s2("Outputs/Output79/nodeData/blackHoleCount");
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
 
-        // read data
-        long *buffer = new long[nvalues]; // = same as malloc
-        dataset.read(buffer,PredType::NATIVE_LONG);
+        //cout << "Reading DataSet '" << s << "'" << endl;
 
-        // the data is stored in buffer now, so we can delete the dataset;
-        // to do this, call delete on the pointer to the dataset
-        dataset.close();
-        // delete dataset is not necessary, if it is a variable on the heap.
-        // Then it is removed automatically when the function ends.
-        delete dptr;
+        vector<long> fileStart;
+        vector<long*> buffers;
+        long bufferStart;
+        long bufferRows;
+        int ncomponents = -1;
 
-        //std::vector<int> data_out(NX);
-        //H5Dread(dataset, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &data_out[0]);
-        // --> this did not work, do not know why.
-        //cout << "status: " << status << endl;
-        //int data_out2[dims_out[0]];
-        //dataset.read(data_out, PredType::NATIVE_LONG, memspace, filespace);
-        // --> this caused problems with incompatible memspace and filespace etc.
+        getFileRowStarts(s, fileStart);
+        nvalues = fileStart.back();
+        getRangesSpan(ranges, nvalues, bufferStart, bufferRows);
 
-        /*cout << "First values: ";
-        for (int j = 0; j < 10; j++) {
-            cout << buffer[j] << " ";
-        }
-        cout << endl;
-        */
+        for (size_t f=0; f<fps.size(); f++) {
+            if (!hasPath(fps[f], s)) {
+                continue; // this output is missing in this file
+            }
 
-        DataBlock b;
-        b.nvalues = nvalues;
-        b.longval = buffer;
-        b.name = s;
-        datablocks.push_back(b);
-        // b is added to datablocks-vector now
+            DataSet dataset = openDataSetForReading(f, s);
 
+            // check class type
+            H5T_class_t type_class = dataset.getTypeClass();
+            if (type_class != H5T_INTEGER) {
+                cout << "Data does not have long type!" << endl;
+                abort();
+            }
+            // check byte order
+            IntType intype = dataset.getIntType();
+            H5std_string order_string;
+            H5T_order_t order = intype.getOrder(order_string);
+            //cout << order_string << endl;
 
-        return buffer;
-    }
+            // check again data sizes
+            if (sizeof(long) != intype.getSize()) {
+                cout << "Mismatch of long data type." << endl;
+                abort();
+            }
 
+            // get dataspace of the dataset (the array length or so)
+            DataSpace dataspace = dataset.getSpace();
 
-    double* GalacticusReader::readDoubleDataSet(const std::string s, long &nvalues) {
-        // read a double-type dataset
-        //std::string s2("Outputs/Output79/nodeData/blackHoleCount");
-        // DataSet dataset = fp->openDataSet(s);
-        // rather need pointer to dataset in order to delete it later on:
+            // get number of dimensions in dataspace;
+            // newer Galacticus versions store vectors (positions, velocities, luminosities)
+            // as 2-dimensional arrays with one row per node
+            int rank = dataspace.getSimpleExtentNdims();
+            if (rank > 2) {
+                cout << "ERROR: Cannot cope with datasets of more than 2 dimensions!" << endl;
+                abort();
+            }
 
-        //cout << "Reading DataSet '" << s << "'" << endl;
+            hsize_t dims_out[2];
+            dataspace.getSimpleExtentDims(dims_out, NULL);
+            int ncomp = (rank == 2) ? dims_out[1] : 0;
+            if (ncomponents < 0) {
+                ncomponents = ncomp;
+                for (int j=0; j<ncomponents || j==0; j++) {
+                    buffers.push_back(new long[bufferRows]); // = same as malloc
+                }
+            } else if (ncomp != ncomponents) {
+                cout << "ERROR: Dataset " << s << " has different dimensions in " << fileNames[f] << "!" << endl;
+                abort();
+            }
 
-        DataSet *dptr = new DataSet(fp->openDataSet(s));
-        DataSet dataset = *dptr; // for convenience
+            // read data; if ranges are given, read only these rows into a
+            // buffer from the first to the last of them (e.g. only the rows
+            // of the partition), the rows in between stay undefined;
+            // components are read one by one with a strided selection
+            for (size_t j=0; j<buffers.size(); j++) {
+                if (fps.size() == 1 && !ranges && rank == 1) {
+                    dataset.read(buffers[j], PredType::NATIVE_LONG);
+                } else {
+                    readFileRows(dataset, buffers[j], PredType::NATIVE_LONG, bufferStart, bufferRows, fileStart[f], ranges, j);
+                }
+            }
 
-        // check class type
-        H5T_class_t type_class = dataset.getTypeClass();
-        if (type_class != H5T_FLOAT) {
-            cout << "Data does not have double type!" << endl;
-            abort();
+            dataset.close();
         }
-        // check byte order
-        FloatType intype = dataset.getFloatType();
-        H5std_string order_string;
-        H5T_order_t order = intype.getOrder(order_string);
-        //cout << order_string << endl;
 
-        // check again data sizes
-        if (sizeof(double) != intype.getSize()) {
-            cout << "Mismatch of double data type." << endl;
+        if (ncomponents < 0) {
+            cout << "ERROR: " << s << " does not exist in any of the data files!" << endl;
             abort();
         }
+        ioBytes += getNumRowsInRanges(ranges, nvalues) * sizeof(long) * buffers.size();
+
+        for (size_t j=0; j<buffers.size(); j++) {
+            DataBlock b;
+            b.nvalues = bufferRows;
+            b.first = bufferStart;
+            b.longval = buffers[j];
+            b.name = s;
+            b.complete = (ranges == NULL);
+            datablocks.push_back(b);
+            // b is added to datablocks-vector now
+        }
 
-        size_t dsize = intype.getSize();
-        //cout << "Data size is " << dsize << endl;
+        return ncomponents;
+    }
 
-        // get dataspace of the dataset (the array length or so)
-        DataSpace dataspace = dataset.getSpace();
-        //hid_t dataspace = H5Dget_space(dataset); --> this does not work!! At least not with dataset defined as above!
-
-        // get number of dimensions in dataspace
-        int rank = dataspace.getSimpleExtentNdims();
-        //cout << "Dataspace rank is " << rank << endl;
-        // I expect this to be 1 for all Galacticus datasets!
-        // There are no 2 (or more) dimensional arrays stored in one dataset, are there?
-        if (rank > 1) {
-            cout << "ERROR: Cannot cope with multi-dimensional datasets!" << endl;
-            abort();
-        }
 
-        hsize_t dims_out[1];
-        int ndims = dataspace.getSimpleExtentDims(dims_out, NULL);
-        //cout << "dimension " << (unsigned long)(dims_out[0]) << endl;
-        nvalues = dims_out[0];
+    int GalacticusReader::readDoubleDataSet(const std::string s, long &nvalues, const vector<RowRange> *ranges) {
+        // read a double-type dataset (see readLongDataSet)
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
 
-        // read data
-        double *buffer = new double[nvalues];
-        dataset.read(buffer,PredType::NATIVE_DOUBLE);
+        //cout << "Reading DataSet '" << s << "'" << endl;
 
-        // the data is stored in buffer now, so we can delete the dataset;
-        // to do this, call delete on the pointer to the dataset
-        dataset.close();
-        delete dptr;
+        vector<long> fileStart;
+        vector<double*> buffers;
+        long bufferStart;
+        long bufferRows;
+        int ncomponents = -1;
+        bool converted = false;
 
-        /*cout << "First values: ";
-        for (int j = 0; j < 10; j++) {
-            cout << buffer[j] << " ";
-        }
-        cout << endl;
-        */
+        getFileRowStarts(s, fileStart);
+        nvalues = fileStart.back();
+        getRangesSpan(ranges, nvalues, bufferStart, bufferRows);
 
-        DataBlock b;
-        b.nvalues = nvalues;
-        b.doubleval = buffer;
-        b.name = s;
-        datablocks.push_back(b);
+        for (size_t f=0; f<fps.size(); f++) {
+            if (!hasPath(fps[f], s)) {
+                continue; // this output is missing in this file
+            }
+
+            DataSet dataset = openDataSetForReading(f, s);
+
+            // check class type
+            H5T_class_t type_class = dataset.getTypeClass();
+            if (type_class != H5T_FLOAT) {
+                cout << "Data does not have double type!" << endl;
+                abort();
+            }
+
+            // repacked files may contain values with converted units already
+            if (H5Aexists(dataset.getId(), "unitsConverted") > 0) {
+                double h;
+                Attribute att = dataset.openAttribute("unitsConverted");
+                att.read(PredType::NATIVE_DOUBLE, &h);
+                if (fabs(h - hubble_h) > 1e-6) {
+                    cout << "ERROR: " << s << " in " << fileNames[f] << " was repacked with converted units for h = " << h
+                         << ", but h = " << hubble_h << " is used now." << endl;
+                    abort();
+                }
+                converted = true;
+            }
+            // check byte order
+            FloatType intype = dataset.getFloatType();
+            H5std_string order_string;
+            H5T_order_t order = intype.getOrder(order_string);
+            //cout << order_string << endl;
+
+            // check again data sizes
+            if (sizeof(double) != intype.getSize()) {
+                cout << "Mismatch of double data type." << endl;
+                abort();
+            }
+
+            // get dataspace of the dataset (the array length or so)
+            DataSpace dataspace = dataset.getSpace();
+
+            // get number of dimensions in dataspace (see readLongDataSet)
+            int rank = dataspace.getSimpleExtentNdims();
+            if (rank > 2) {
+                cout << "ERROR: Cannot cope with datasets of more than 2 dimensions!" << endl;
+                abort();
+            }
+
+            hsize_t dims_out[2];
+            dataspace.getSimpleExtentDims(dims_out, NULL);
+            int ncomp = (rank == 2) ? dims_out[1] : 0;
+            if (ncomponents < 0) {
+                ncomponents = ncomp;
+                for (int j=0; j<ncomponents || j==0; j++) {
+                    buffers.push_back(new double[bufferRows]);
+                }
+            } else if (ncomp != ncomponents) {
+                cout << "ERROR: Dataset " << s << " has different dimensions in " << fileNames[f] << "!" << endl;
+                abort();
+            }
+
+            // read data (see readLongDataSet)
+            for (size_t j=0; j<buffers.size(); j++) {
+                if (fps.size() == 1 && !ranges && rank == 1) {
+                    dataset.read(buffers[j], PredType::NATIVE_DOUBLE);
+                } else {
+                    readFileRows(dataset, buffers[j], PredType::NATIVE_DOUBLE, bufferStart, bufferRows, fileStart[f], ranges, j);
+                }
+            }
+
+            dataset.close();
+        }
 
+        if (ncomponents < 0) {
+            cout << "ERROR: " << s << " does not exist in any of the data files!" << endl;
+            abort();
+        }
+        ioBytes += getNumRowsInRanges(ranges, nvalues) * sizeof(double) * buffers.size();
+
+        for (size_t j=0; j<buffers.size(); j++) {
+            DataBlock b;
+            b.nvalues = bufferRows;
+            b.first = bufferStart;
+            b.doubleval = buffers[j];
+            b.name = s;
+            b.complete = (ranges == NULL);
+            b.converted = converted;
+            datablocks.push_back(b);
+        }
 
-        return buffer;
+        return ncomponents;
     }
 
     bool GalacticusReader::getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result) {
+        bool isNull = false;
+
         //reroute constant items:
         if(thisItem->getIsConstItem() == true) {
             getConstItem(thisItem, result);
@@ -608,7 +2130,14 @@ namespace Galacticus {
             printf("We never told you to read headers...\n");
             exit(EXIT_FAILURE);
         } else {
-            getDataItem(thisItem, result);
+            isNull = getDataItem(thisItem, result);
+        }
+
+        if (stats) {
+            stats->addValue(thisItem, current_snapnum, isNull, result);
+        }
+        if (checksums) {
+            checksums->addValue(thisItem, current_snapnum, isNull, result);
         }
         //cout << " again ioutput: " << ioutput << endl;
         //check assertions
@@ -617,7 +2146,7 @@ namespace Galacticus {
         //apply conversion
         //applyConversions(thisItem, result);
 
-        return 0;
+        return isNull;
     }
 
     bool GalacticusReader::getDataItem(DBDataSchema::DataObjDesc * thisItem, void* result) {
@@ -657,6 +2186,7 @@ namespace Galacticus {
         double satelliteBoundMass;
         double SFRdisk;
         double SFRspheroid;
+        double abundance;
         map<string,int>::iterator it;
         double x,y,z;
 
@@ -694,15 +2224,51 @@ namespace Galacticus {
             return isNull;
         }
 
+        // forestId: depthFirstId of the root node of the tree;
+        // both use the same numbering scheme as dbId
         if (thisItem->getDataObjName().compare("forestId") == 0) {
-            *(long*) result = 0;
-            isNull = true;
+            if (!treeIndex.isBuilt() && !buildTreeIndex()) {
+                *(long*) result = 0;
+                return true;
+            }
+            *(long*) result = (fileNum * snapnumfactor + current_snapnum) * rowfactor + treeIndex.getForestId(countInBlock);
             return isNull;
         }
 
         if (thisItem->getDataObjName().compare("depthFirstId") == 0) {
-            *(long*) result = 0;
-            isNull = true;
+            if (!treeIndex.isBuilt() && !buildTreeIndex()) {
+                *(long*) result = 0;
+                return true;
+            }
+            *(long*) result = (fileNum * snapnumfactor + current_snapnum) * rowfactor + treeIndex.getDepthFirstId(countInBlock);
+            return isNull;
+        }
+
+        // dbId of the same node in the next/previous output, NULL if it
+        // does not exist there (e.g. after merging)
+        if (thisItem->getDataObjName().compare("descendantId") == 0) {
+            if (descendantSnapnum == -1) {
+                descendantSnapnum = buildLinks(descendantRow, 1);
+            }
+            if (descendantSnapnum < 0 || descendantRow[countInBlock] < 0) {
+                *(long*) result = 0;
+                isNull = true;
+            } else {
+                *(long*) result = (fileNum * snapnumfactor + descendantSnapnum) * rowfactor + descendantRow[countInBlock];
+            }
+            return isNull;
+        }
+
+        if (thisItem->getDataObjName().compare("progenitorId") == 0) {
+            if (progenitorSnapnum == -1) {
+                progenitorSnapnum = buildLinks(progenitorRow, -1);
+            }
+            if (progenitorSnapnum < 0 || progenitorRow[countInBlock] < 0) {
+                *(long*) result = 0;
+                isNull = true;
+            } else {
+                *(long*) result = (fileNum * snapnumfactor + progenitorSnapnum) * rowfactor + progenitorRow[countInBlock];
+            }
             return isNull;
         }
 
@@ -713,7 +2279,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    satelliteNodeIndex = b.longval[countInBlock];
+                    satelliteNodeIndex = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (satelliteNodeIndex)" << endl;
@@ -724,7 +2290,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    satelliteStatus = b.longval[countInBlock];
+                    satelliteStatus = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (satelliteStatus)" << endl;
@@ -735,7 +2301,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    nodeIndex = b.longval[countInBlock];
+                    nodeIndex = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (nodeIndex)" << endl;
@@ -759,7 +2325,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    satelliteNodeIndex = b.longval[countInBlock];
+                    satelliteNodeIndex = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (satelliteNodeIndex)" << endl;
@@ -770,7 +2336,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    satelliteStatus = b.longval[countInBlock];
+                    satelliteStatus = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (satelliteStatus)" << endl;
@@ -781,7 +2347,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    nodeIndex = b.longval[countInBlock];
+                    nodeIndex = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (nodeIndex)" << endl;
@@ -805,7 +2371,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    parentIndex = b.longval[countInBlock];
+                    parentIndex = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (parentIndex)" << endl;
@@ -816,7 +2382,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    satelliteStatus = b.longval[countInBlock];
+                    satelliteStatus = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (satelliteStatus)" << endl;
@@ -827,7 +2393,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.longval) {
-                    nodeIndex = b.longval[countInBlock];
+                    nodeIndex = b.longval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (nodeIndex)" << endl;
@@ -852,7 +2418,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    basicMass = b.doubleval[countInBlock];
+                    basicMass = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (basicMass)" << endl;
@@ -863,7 +2429,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    satelliteBoundMass = b.doubleval[countInBlock];
+                    satelliteBoundMass = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (satelliteBoundMass)" << endl;
@@ -887,7 +2453,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    SFRspheroid = b.doubleval[countInBlock];
+                    SFRspheroid = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (spheroidStarFormationRate)" << endl;
@@ -897,7 +2463,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    SFRdisk = b.doubleval[countInBlock];
+                    SFRdisk = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (diskStarFormationRate)" << endl;
@@ -914,7 +2480,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    abundance = b.doubleval[countInBlock];
+                    abundance = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (diskAbundancesGasMetals)" << endl;
@@ -929,7 +2495,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    abundance = b.doubleval[countInBlock];
+                    abundance = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (diskAbundancesStellarMetals)" << endl;
@@ -944,7 +2510,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    abundance = b.doubleval[countInBlock];
+                    abundance = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (hotHaloAbundancesMetals)" << endl;
@@ -959,7 +2525,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    abundance = b.doubleval[countInBlock];
+                    abundance = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (spheroidAbundancesGasMetals)" << endl;
@@ -974,7 +2540,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    abundance = b.doubleval[countInBlock];
+                    abundance = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (spheroidAbundancesStellarMetals)" << endl;
@@ -990,7 +2556,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    x = b.doubleval[countInBlock];
+                    x = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (positionPositionX)" << endl;
@@ -998,7 +2564,6 @@ namespace Galacticus {
             }
 
             *(int*) result = (int) (x*hubble_h/scale * (1024/1000.) );
-            isNull = true;
             return isNull;
         }
 
@@ -1007,7 +2572,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    y = b.doubleval[countInBlock];
+                    y = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (positionPositionY)" << endl;
@@ -1015,7 +2580,6 @@ namespace Galacticus {
             }
 
             *(int*) result = (int) (y*hubble_h/scale * (1024/1000.) );
-            isNull = true;
             return isNull;
         }
 
@@ -1024,7 +2588,7 @@ namespace Galacticus {
             if (it != dataSetMap.end()) {
                 b = datablocks[it->second];
                 if (b.doubleval) {
-                    z = b.doubleval[countInBlock];
+                    z = b.doubleval[countInBlock - b.first];
                 }
             } else {
                 cout << "Error: No corresponding data found!" << " (positionPositionZ)" << endl;
@@ -1032,7 +2596,6 @@ namespace Galacticus {
             }
 
             *(int*) result = (int) (z*hubble_h/scale * (1024/1000.) );
-            isNull = true;
             return isNull;
         }
 
@@ -1049,6 +2612,21 @@ namespace Galacticus {
         // that it is in correct order!
 
 
+        // derived columns, i.e. values from the row referenced by a node index,
+        // e.g. basicMass@parentIndex (units are converted as for the source column)
+        if (thisItem->getDataObjName().find('@') != string::npos) {
+            DerivedColumn &d = getDerivedColumn(thisItem->getDataObjName());
+            isNull = d.isNull[countInBlock];
+            if (d.doubleval.size() > 0 && d.converted) {
+                *(double*)(result) = d.doubleval[countInBlock];
+            } else if (d.doubleval.size() > 0) {
+                *(double*)(result) = convertUnits(d.sourceName, d.doubleval[countInBlock], scale);
+            } else {
+                *(long*)(result) = d.longval[countInBlock];
+            }
+            return isNull;
+        }
+
         // quickly access the correct data block by name (should have redshift removed already),
         // but make sure that key really exists in the map
         // should do this at the end => only for those datasets that got no special treatment!
@@ -1056,34 +2634,18 @@ namespace Galacticus {
         it = dataSetMap.find(thisItem->getDataObjName());
         if (it != dataSetMap.end()) {
             b = datablocks[it->second];
+            if (b.nulls) {
+                isNull = b.nulls[countInBlock - b.first];
+            }
             if (b.longval) {
-                *(long*)(result) = b.longval[countInBlock];
+                *(long*)(result) = b.longval[countInBlock - b.first];
                 return isNull;
             } else if (b.doubleval) {
-                *(double*)(result) = b.doubleval[countInBlock];
-
-                // apply unit conversion for the necessary parts:
-                if (thisItem->getDataObjName().compare("blackHoleMass") == 0
-                    || thisItem->getDataObjName().compare("basicMass") == 0
-                    || thisItem->getDataObjName().compare("diskMassGas") == 0
-                    || thisItem->getDataObjName().compare("diskMassStellar") == 0
-                    || thisItem->getDataObjName().compare("diskStarFormationRate") == 0
-                    || thisItem->getDataObjName().compare("hotHaloMass") == 0
-                   // || thisItem->getDataObjName().compare("satelliteBoundMass") == 0 => already covered above at HaloMass
-                    || thisItem->getDataObjName().compare("spheroidMassGas") == 0
-                    || thisItem->getDataObjName().compare("spheroidMassStellar") == 0
-                    || thisItem->getDataObjName().compare("spheroidStarFormationRate") == 0
-                   ) {
-                    *(double*)(result) = b.doubleval[countInBlock] * hubble_h;
-                }
-                if (thisItem->getDataObjName().compare("diskRadius") == 0
-                    || thisItem->getDataObjName().compare("hotHaloOuterRadius") == 0
-                    || thisItem->getDataObjName().compare("positionPositionX") == 0
-                    || thisItem->getDataObjName().compare("positionPositionY") == 0
-                    || thisItem->getDataObjName().compare("positionPositionZ") == 0
-                    || thisItem->getDataObjName().compare("spheroidRadius") == 0
-                   ) {
-                    *(double*)(result) = b.doubleval[countInBlock] * hubble_h/scale;
+                // apply unit conversion for the necessary parts
+                if (b.converted) {
+                    *(double*)(result) = b.doubleval[countInBlock - b.first];
+                } else {
+                    *(double*)(result) = convertUnits(thisItem->getDataObjName(), b.doubleval[countInBlock - b.first], scale);
                 }
                 return isNull;
 
@@ -1102,6 +2664,33 @@ namespace Galacticus {
         return isNull;
     }
 
+    double GalacticusReader::convertUnits(const string name, double value, double scale) {
+        // convert masses and lengths to units with h
+        if (name.compare("blackHoleMass") == 0
+            || name.compare("basicMass") == 0
+            || name.compare("diskMassGas") == 0
+            || name.compare("diskMassStellar") == 0
+            || name.compare("diskStarFormationRate") == 0
+            || name.compare("hotHaloMass") == 0
+           // || name.compare("satelliteBoundMass") == 0 => already covered above at HaloMass
+            || name.compare("spheroidMassGas") == 0
+            || name.compare("spheroidMassStellar") == 0
+            || name.compare("spheroidStarFormationRate") == 0
+           ) {
+            return value * hubble_h;
+        }
+        if (name.compare("diskRadius") == 0
+            || name.compare("hotHaloOuterRadius") == 0
+            || name.compare("positionPositionX") == 0
+            || name.compare("positionPositionY") == 0
+            || name.compare("positionPositionZ") == 0
+            || name.compare("spheroidRadius") == 0
+           ) {
+            return value * hubble_h/scale;
+        }
+        return value;
+    }
+
     void GalacticusReader::getConstItem(DBDataSchema::DataObjDesc * thisItem, void* result) {
         memcpy(result, thisItem->getConstData(), DBDataSchema::getByteLenOfDType(thisItem->getDataObjDType()));
     }
@@ -1111,6 +2700,10 @@ namespace Galacticus {
         return;
     }
 
+    float GalacticusReader::getHubble_h() {
+        return hubble_h;
+    }
+
     long GalacticusReader::getCurrRow() {
         return currRow;
     }
@@ -1119,14 +2712,87 @@ namespace Galacticus {
         return numOutputs;
     }
 
+    long GalacticusReader::getNumRowsInOutputs() {
+        // total number of rows in all outputs that will be read
+        // (before applying any filter)
+        long total = 0;
+        map<int, OutputMeta>::iterator it;
+
+        for (it = outputMetaMap.begin(); it != outputMetaMap.end(); it++) {
+            if (user_snapnums.size() > 0 && find(user_snapnums.begin(), user_snapnums.end(), it->first) == user_snapnums.end()) {
+                continue;
+            }
+            total += getNumRowsInDataSet(it->second.outputName + string("/nodeIndex"));
+        }
+        return total;
+    }
+
+    void GalacticusReader::sampleNodeIndices(long numSamples, vector<long> &sample) {
+        // about numSamples node indices, evenly strided over all outputs
+        // that will be read (before applying any filter)
+        boost::recursive_mutex::scoped_lock lock(h5Mutex);
+        long stride = getNumRowsInOutputs() / numSamples + 1;
+        vector<long> fileStart;
+        vector<long> buffer;
+        string s;
+
+        sample.clear();
+        for (map<int, OutputMeta>::iterator it = outputMetaMap.begin(); it != outputMetaMap.end(); it++) {
+            if (user_snapnums.size() > 0 && find(user_snapnums.begin(), user_snapnums.end(), it->first) == user_snapnums.end()) {
+                continue;
+            }
+            s = it->second.outputName + string("/nodeIndex");
+            getFileRowStarts(s, fileStart);
+            for (size_t f=0; f<fps.size(); f++) {
+                long nfile = fileStart[f+1] - fileStart[f];
+                if (nfile == 0) {
+                    continue;
+                }
+                hsize_t offset[1] = {0};
+                hsize_t strides[1] = {(hsize_t) stride};
+                hsize_t count[1] = {(hsize_t) ((nfile - 1) / stride + 1)};
+                DataSet dataset = fps[f]->openDataSet(s);
+                DataSpace dataspace = dataset.getSpace();
+                DataSpace memspace(1, count);
+                dataspace.selectHyperslab(H5S_SELECT_SET, count, offset, strides);
+                buffer.resize(count[0]);
+                dataset.read(&buffer[0], PredType::NATIVE_LONG, memspace, dataspace);
+                sample.insert(sample.end(), buffer.begin(), buffer.end());
+                dataset.close();
+            }
+        }
+    }
+
+    int GalacticusReader::getFileNum() {
+        return fileNum;
+    }
+
+    int GalacticusReader::getCurrentSnapnum() {
+        return current_snapnum;
+    }
+
+    long GalacticusReader::getNodeIndex() {
+        // nodeIndex of the current row
+        map<string,int>::iterator it = dataSetMap.find("nodeIndex");
+        if (it == dataSetMap.end() || !datablocks[it->second].longval) {
+            cout << "Error: No corresponding data found!" << " (nodeIndex)" << endl;
+            abort();
+        }
+        return datablocks[it->second].longval[countInBlock - datablocks[it->second].first];
+    }
+
 
     DataBlock::DataBlock() {
         nvalues = 0;
+        first = 0;
         name = "";
         idx = -1;
         doubleval = NULL;
         longval = NULL;
         type = "unknown";
+        complete = true;
+        nulls = NULL;
+        converted = false;
     };
 
     /* // copy constructor, probably needed for vectors? -- works better without, got strange error messages when using this and trying to use push_back
@@ -1142,17 +2808,40 @@ namespace Galacticus {
 
     void DataBlock::deleteData() {
         if (longval) {
-            delete longval;
+            delete[] longval;
+            longval = NULL;
             nvalues = 0;
         }
         if (doubleval) {
-            delete doubleval;
+            delete[] doubleval;
+            doubleval = NULL;
             nvalues = 0;
         }
+        if (nulls) {
+            delete[] nulls;
+            nulls = NULL;
+        }
+    }
+
+
+    DerivedColumn::DerivedColumn() {
+        converted = false;
+    }
+
+
+    RowRange::RowRange() {
+        start = 0;
+        count = 0;
+    }
+
+    RowRange::RowRange(long newStart, long newCount) {
+        start = newStart;
+        count = newCount;
     }
 
     OutputMeta::OutputMeta() {
         ioutput = 0;
+        snapnum = 0;
         outputExpansionFactor = 0;
         outputTime = 0;
     };
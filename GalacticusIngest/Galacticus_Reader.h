@@ -25,6 +25,9 @@
 #include <list>
 #include <sstream>
 #include <map>
+#include <set>
+#include <time.h>
+#include <boost/thread/recursive_mutex.hpp>
 
 #ifndef Galacticus_Galacticus_Reader_h
 #define Galacticus_Galacticus_Reader_h
@@ -37,6 +40,17 @@ using namespace std;
 #include "H5Cpp.h"
 using namespace H5;
 
+#include "Galacticus_Filter.h"
+#include "Galacticus_ZoneMap.h"
+#include "Galacticus_Stats.h"
+#include "Galacticus_TreeIndex.h"
+#include "Galacticus_RadixSort.h"
+#include "Galacticus_Manifest.h"
+#include "Galacticus_IOProfile.h"
+#include "Galacticus_Assertions.h"
+#include "Galacticus_Aggregates.h"
+#include "Galacticus_Checksums.h"
+
 extern "C" herr_t file_info(hid_t loc_id, const char *name, const H5L_info_t *linfo,
                                     void *opdata);
 
@@ -59,11 +73,15 @@ namespace Galacticus {
     class DataBlock {
         public:
             long nvalues;   // number of values in the block
+            long first;     // row of the output of the first value (> 0, if only a part was read)
             string name;
             long idx;
             double *doubleval;
             long *longval;
             string type;
+            bool complete;  // false, if only some rows were read
+            char *nulls;    // optional null flags per row (set by assertions)
+            bool converted; // units are converted already (repacked file)
 
             DataBlock();
             //DataBlock(DataBlock &source);
@@ -75,15 +93,50 @@ namespace Galacticus {
     // DataSet, only a part, but this is what hyperslabs are for!!
     // Hmmm ... does DataSet contain all the data or just a handle to these data???
 
+
+    // values of a column taken from another row of the same output, which is
+    // referenced by node index, e.g. basicMass@parentIndex = mass of the host
+    class DerivedColumn {
+        public:
+            string sourceName;
+            bool converted;         // source values are in database units already (repacked)
+            vector<double> doubleval;
+            vector<long> longval;
+            vector<char> isNull;    // 1, if the referenced node does not exist or its value is NULL
+
+            DerivedColumn();
+    };
+
+
+    // a contiguous range of rows in a dataset, used for reading only parts of it
+    class RowRange {
+        public:
+            long start;
+            long count;
+
+            RowRange();
+            RowRange(long newStart, long newCount);
+    };
+
     
     class GalacticusReader : public Reader {
     private:
+        // the HDF5 library is usually not built thread-safe, so all calls
+        // to it are serialized, if several readers run in one process
+        static boost::recursive_mutex h5Mutex;
+
         string fileName;
         string mapFile;
 
         ifstream fileStream;
 
-        H5File* fp;//holds the opened hdf5 file
+        H5File* fp;//holds the opened hdf5 file (the first one, used for meta data)
+
+        // a run split into several files (e.g. one per MPI process) is read
+        // as one source: the rows of each output are numbered consecutively
+        // across all files, in the given order of the files
+        vector<string> fileNames;
+        vector<H5File*> fps;
         long ioutput; // number of current output
         long numOutputs; // total number of outputs (one for reach redshift)
         long numDataSets; // number of DataSets (= row fields, = columns) in each output
@@ -124,31 +177,207 @@ namespace Galacticus {
         // (one complete Output* block or a part of it)
         vector<DataBlock> datablocks;
 
+        // optional row filter, evaluated on each new block; only the selected
+        // rows are returned by getNextRow, and datasets not needed by the filter
+        // are read only for the chunks that contain selected rows
+        RowFilter *filter;
+        vector<long> selectedRows;
+        bool useSelection;
+        long numSelected;
+        long countSelected;
+        bool blockLoaded;
+        long selectChunkSize; // chunk size for partial reads of non-chunked datasets
+
+        // optional conditions for routing rows to further tables; for each
+        // row of the current block one bit per route (set, if fulfilled)
+        vector<RowFilter*> routeFilters;
+        vector<unsigned long> routeMasks;
+
+        // optional value ranges for columns, e.g. for extracting subvolumes;
+        // chunks are skipped using zone maps (min/max per chunk), the
+        // remaining rows are checked with a filter built from the ranges
+        vector<string> rangeColumns;
+        vector<double> rangeMin;
+        vector<double> rangeMax;
+        RowFilter *rangeFilter;
+        ZoneMap *zoneMap;
+        string zoneMapFile;
+
+        // optional assertions for the values of columns (from the field map),
+        // checked for each output after reading; a failed output is not
+        // ingested and not recorded in the manifest
+        BlockAsserter *asserter;
+        bool blockFailed;
+
+        // optional statistics of all ingested values (per snapnum and column)
+        StatsCollector *stats;
+
+        // optional aggregations (counts, sums, histograms, grid cells) of
+        // the ingested rows per snapnum, computed from the column arrays
+        Aggregator *aggregator;
+
+        // optional checksums of all ingested values (per snapnum and column)
+        ChecksumCollector *checksums;
+
+        // optional projection: only these datasets (names without redshift)
+        // are read for each output, e.g. for repacking
+        set<string> projection;
+
+        // optional record of completely ingested outputs, which are skipped
+        IngestManifest *manifest;
+
+        // follow mode: wait for new outputs while the files are still being
+        // written; the newest output is only read when a later one exists
+        // or when the run is regarded as complete
+        bool follow;
+        int pollInterval;       // seconds between checks for new outputs
+        int followTimeout;      // complete after this many seconds without new outputs
+        long followOutputs;     // complete, when this number of outputs exists (0 = no limit)
+        bool followDone;
+        time_t lastNewOutput;
+
+        // names of the current output's datasets (without redshift), for
+        // reading columns that are needed later on (e.g. for tree ids)
+        string blockOutputName;
+        map<string,int> blockMatchNames;
+
+        // forests of the current output, built when first needed
+        TreeIndex treeIndex;
+        bool treeColumnsWarned; // warned already that nodeIndex/parentIndex are missing
+
+        // derived columns of the current output, built when first needed
+        map<string, DerivedColumn> derivedColumns;
+
+        // rows of the same nodes (by nodeIndex) in the previous and next
+        // output (-1 = not found), built when first needed
+        vector<long> progenitorRow;
+        vector<long> descendantRow;
+        int progenitorSnapnum;  // -1 = not built yet, -2 = no such output
+        int descendantSnapnum;
+        long linkChunkRows;     // rows of the other output read at once
+
+        // optional order of the rows inside each output (column name or depthFirstId)
+        string sortKey;
+        int sortThreads;
+
+        // optional deterministic sample: rows are taken, if a hash of
+        // their dbId (and the seed) falls below the fraction
+        double sampleFraction;
+        unsigned long sampleSeed;
+
+        // HDF5 driver and cache settings, and the bytes read from the
+        // datasets for the current output (for the timing report)
+        IOProfile ioProfile;
+        bool usePageBuffer;
+        long ioBytes;   // decoded bytes of the values read for the current output
+
+        // optional partition of each output's rows: only the contiguous range
+        // partStart <= row < partEnd is read (partition partitionIndex of numPartitions)
+        int partitionIndex;
+        int numPartitions;
+        long partStart;
+        long partEnd;
+
+        // for ingesting in segments: getNextRow pauses after segmentRows rows
+        long segmentRows;
+        long rowsInSegment;
+        bool finished;
+
     public:
         GalacticusReader();
         GalacticusReader(string newFileName, int fileNum, vector<int> newSnapnums, float hubble_h);
+        GalacticusReader(vector<string> newFileNames, int fileNum, vector<int> newSnapnums, float hubble_h);
         ~GalacticusReader();
 
+        void init(vector<string> newFileNames, int newFileNum, vector<int> newSnapnums, float newHubble_h);
+
         void openFile(string newFileName);
 
         void closeFile();
 
         void getOutputsMeta(long &numOutputs);
 
+        void setFilter(string expression);
+        int addRoute(string expression);
+        int getNumRoutes();
+        unsigned long getRouteMask();
+        void addRange(string rangeSpec);
+        void setZoneMapFile(string newZoneMapFile);
+        void setStatsFile(string statsFile);
+        void addAssertion(string column, string spec);
+        int getNumFailedOutputs();
+        void addAggregate(string spec, int numThreads);
+        void setChecksumFile(string checksumFile, DBDataSchema::Schema *schema);
+        void setProjection(vector<string> columns);
+        int getNumComponents(const string matchname);
+        bool readNextOutput(string &outputName, long &numRows);
+        void setSortKey(string newSortKey, int newSortThreads);
+        void setManifest(IngestManifest *newManifest);
+        string getOutputSignature(const string outputName);
+        void setPartition(int newPartitionIndex, int newNumPartitions);
+        void setSample(double newSampleFraction, unsigned long newSampleSeed);
+        void setIOProfile(string profileName, long cacheBytes);
+        void checkRowFactor();
+        void setFollow(int newPollInterval, int newFollowTimeout, long newFollowOutputs);
+
+        void setSegmentRows(long newSegmentRows);
+        void startSegment();
+        long getRowsInSegment();
+        bool isFinished();
+
         int getNextRow();
+        int nextOutput(string &outputName);
+        bool isPendingOutput(map<int, OutputMeta>::iterator it);
+        void waitForOutputs();
+        bool reopenFiles();
         int readNextBlock(string outputName); //possibly add startRow (numRow?), numRows? --> but these are global anyway
-        long* readLongDataSet(const string s, long &nvalues);
-        double* readDoubleDataSet(const string s, long &nvalues);
+        void readDataSet(const string s, const string matchname, const vector<RowRange> *ranges);
+        void replaceDataBlock(const string matchname, int k);
+        int readLongDataSet(const string s, long &nvalues, const vector<RowRange> *ranges = NULL);
+        int readDoubleDataSet(const string s, long &nvalues, const vector<RowRange> *ranges = NULL);
+        string getBaseName(const string column);
+        void getSelectedChunks(const string s, vector<RowRange> &ranges);
+        long getChunkSize(const string s);
+        void prepareFilter(RowFilter *f, const string outputName, map<string,int> &matchNameMap);
+        void applyFilter(RowFilter *f, const string outputName, map<string,int> &matchNameMap);
+        void applyRoutes(const string outputName, map<string,int> &matchNameMap);
+        void applySample();
+        void applyAssertions(const string outputName);
+        void applyAggregates(const string outputName);
+        void getAggregateValues(const string column, const vector<long> &rows, vector<double> &values);
+        bool isChunked(const string s);
+        void applyZoneMaps(const string outputName, map<string,int> &matchNameMap);
+        DataBlock getCompleteColumn(const string matchname);
+        long* getCompleteLongColumn(const string matchname);
+        bool hasColumn(const string matchname);
+        bool buildTreeIndex();
+        void buildNodeHash();
+        DerivedColumn & getDerivedColumn(const string name);
+        int buildLinks(vector<long> &linkRow, int direction);
+        void sortSelection();
+        double convertUnits(const string name, double value, double scale);
 
         long getNumRowsInDataSet(string s);
+        bool hasPath(H5File *file, const string s);
+        void getFileRowStarts(const string s, vector<long> &fileStart);
+        H5File* getFileWithDataSet(const string s);
+        H5File* openH5File(const string name);
+        DataSet openDataSetForReading(int f, const string s);
 
         vector<string> getDataSetNames();
 
         void setCurrRow(long n);
         long getCurrRow();
+        float getHubble_h();
         long getNumOutputs();
+        long getNumRowsInOutputs();
+        void sampleNodeIndices(long numSamples, vector<long> &sample);
+        int getFileNum();
+        int getCurrentSnapnum();
+        long getNodeIndex();
 
         int getSnapnum(long ioutput);
+        vector<int> getSnapnums();
         
         bool getItemInRow(DBDataSchema::DataObjDesc * thisItem, bool applyAsserters, bool applyConverters, void* result);
 
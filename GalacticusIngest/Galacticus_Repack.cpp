@@ -0,0 +1,266 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Galacticus_Repack.h"
+
+namespace Galacticus {
+
+    // fields computed by the reader and the datasets they are computed from;
+    // these datasets are kept, but without unit conversion, since the
+    // computations use the values as they are in the file
+    static const int numComputedFields = 24;
+    static const char *computedFields[numComputedFields][4] = {
+        {"dbId", NULL, NULL, NULL},
+        {"snapnum", NULL, NULL, NULL},
+        {"scale", NULL, NULL, NULL},
+        {"redshift", NULL, NULL, NULL},
+        {"NInFileSnapnum", NULL, NULL, NULL},
+        {"fileNum", NULL, NULL, NULL},
+        {"phkey", NULL, NULL, NULL},
+        {"forestId", "nodeIndex", "parentIndex", NULL},
+        {"depthFirstId", "nodeIndex", "parentIndex", NULL},
+        {"descendantId", "nodeIndex", NULL, NULL},
+        {"progenitorId", "nodeIndex", NULL, NULL},
+        {"rockstarId", "satelliteNodeIndex", "satelliteStatus", "nodeIndex"},
+        {"HostHaloId", "satelliteNodeIndex", "satelliteStatus", "nodeIndex"},
+        {"MainHaloId", "parentIndex", "satelliteStatus", "nodeIndex"},
+        {"HaloMass", "basicMass", "satelliteBoundMass", NULL},
+        {"SFR", "spheroidStarFormationRate", "diskStarFormationRate", NULL},
+        {"MZgasDisk", "diskAbundancesGasMetals", NULL, NULL},
+        {"MZstarDisk", "diskAbundancesStellarMetals", NULL, NULL},
+        {"MZhotHalo", "hotHaloAbundancesMetals", NULL, NULL},
+        {"MZgasSpheroid", "spheroidAbundancesGasMetals", NULL, NULL},
+        {"MZstarSpheroid", "spheroidAbundancesStellarMetals", NULL, NULL},
+        {"ix", "positionPositionX", NULL, NULL},
+        {"iy", "positionPositionY", NULL, NULL},
+        {"iz", "positionPositionZ", NULL, NULL}
+    };
+
+    Repacker::Repacker() {
+        reader = NULL;
+        chunkRows = 0;
+        deflateLevel = 0;
+        convert = false;
+    }
+
+    Repacker::Repacker(GalacticusReader *newReader, string newOutFileName, long newChunkRows, int newDeflateLevel, bool newConvert) {
+        reader = newReader;
+        outFileName = newOutFileName;
+        chunkRows = newChunkRows;
+        deflateLevel = newDeflateLevel;
+        convert = newConvert;
+    }
+
+    void Repacker::addDependencies(const string field) {
+        string::size_type pos = field.find('@');
+
+        // derived columns: source column, reference column and nodeIndex
+        if (pos != string::npos) {
+            string source = reader->getBaseName(field.substr(0, pos));
+            columns.insert(source);
+            rawColumns.insert(source);
+            columns.insert(field.substr(pos + 1));
+            columns.insert("nodeIndex");
+            return;
+        }
+
+        for (int i=0; i<numComputedFields; i++) {
+            if (field.compare(computedFields[i][0]) == 0) {
+                for (int j=1; j<4 && computedFields[i][j]; j++) {
+                    columns.insert(computedFields[i][j]);
+                    rawColumns.insert(computedFields[i][j]);
+                }
+                return;
+            }
+        }
+
+        columns.insert(reader->getBaseName(field));
+    }
+
+    void Repacker::addFieldMap(vector<string> dataFileFields) {
+        for (size_t i=0; i<dataFileFields.size(); i++) {
+            addDependencies(dataFileFields[i]);
+        }
+    }
+
+    void Repacker::addRawColumn(const string field) {
+        // e.g. for assertions, which check the values as they are in the file
+        string name = reader->getBaseName(field);
+        columns.insert(name);
+        rawColumns.insert(name);
+    }
+
+    void Repacker::copyAttributes(H5::Group &source, H5::Group &target) {
+        // e.g. outputExpansionFactor and outputTime of each output
+        for (int i=0; i<source.getNumAttrs(); i++) {
+            H5::Attribute att = source.openAttribute((unsigned int) i);
+            H5::DataType type = att.getDataType();
+            H5::DataSpace space = att.getSpace();
+
+            if (H5Tis_variable_str(type.getId()) > 0) {
+                continue;
+            }
+            vector<char> buffer(type.getSize() * (space.getSimpleExtentNpoints() + 1));
+            att.read(type, &buffer[0]);
+
+            H5::Attribute copy = target.createAttribute(att.getName(), type, space);
+            copy.write(type, &buffer[0]);
+        }
+    }
+
+    void Repacker::writeColumn(H5::Group &group, const string name, int ncomp, long nvalues, double scale) {
+        // one- or two-dimensional dataset (ncomp components) from the datablocks
+        int rank = (ncomp > 0) ? 2 : 1;
+        int n = (ncomp > 0) ? ncomp : 1;
+        hsize_t dims[2] = {(hsize_t) nvalues, (hsize_t) n};
+        hsize_t chunk[2] = {(hsize_t) ((nvalues < chunkRows) ? nvalues : chunkRows), (hsize_t) n};
+        vector<DataBlock> blocks;
+        bool isLong;
+        bool converted = false;
+
+        for (int j=0; j<n; j++) {
+            if (ncomp > 0) {
+                stringstream ss;
+                ss << name << "[" << j << "]";
+                blocks.push_back(reader->getCompleteColumn(ss.str()));
+            } else {
+                blocks.push_back(reader->getCompleteColumn(name));
+            }
+        }
+        isLong = (blocks[0].longval != NULL);
+
+        H5::DSetCreatPropList plist;
+        if (nvalues > 0) {
+            plist.setChunk(rank, chunk);
+            if (deflateLevel > 0) {
+                plist.setShuffle();
+                plist.setDeflate(deflateLevel);
+            }
+        }
+        H5::DataSpace space(rank, dims);
+        H5::DataSet dataset = group.createDataSet(name, isLong ? H5::PredType::NATIVE_LONG : H5::PredType::NATIVE_DOUBLE, space, plist);
+
+        if (isLong) {
+            vector<long> values(nvalues * n);
+            for (int j=0; j<n; j++) {
+                for (long i=0; i<nvalues; i++) {
+                    values[i*n + j] = blocks[j].longval[i];
+                }
+            }
+            if (nvalues > 0) {
+                dataset.write(&values[0], H5::PredType::NATIVE_LONG);
+            }
+        } else {
+            vector<double> values(nvalues * n);
+            for (int j=0; j<n; j++) {
+                // the same conversion as for ingesting, with the column name
+                // used in field maps (i.e. with component index)
+                string column = blocks[j].converted ? "" : name;
+                if (ncomp > 0 && column != "") {
+                    stringstream ss;
+                    ss << name << "[" << j << "]";
+                    column = ss.str();
+                }
+                bool apply = (convert && column != "" && rawColumns.find(name) == rawColumns.end()
+                              && reader->convertUnits(column, 1., scale) != 1.);
+                for (long i=0; i<nvalues; i++) {
+                    values[i*n + j] = apply ? reader->convertUnits(column, blocks[j].doubleval[i], scale) : blocks[j].doubleval[i];
+                }
+                converted = converted || apply || blocks[j].converted;
+            }
+            if (nvalues > 0) {
+                dataset.write(&values[0], H5::PredType::NATIVE_DOUBLE);
+            }
+        }
+
+        if (converted) {
+            double h = reader->getHubble_h();
+            H5::DataSpace scalar(H5S_SCALAR);
+            H5::Attribute att = dataset.createAttribute("unitsConverted", H5::PredType::NATIVE_DOUBLE, scalar);
+            att.write(H5::PredType::NATIVE_DOUBLE, &h);
+        }
+    }
+
+    int Repacker::run() {
+        boost::posix_time::ptime startTime;
+        boost::posix_time::ptime endTime;
+        string outputName;
+        string groupName;
+        set<string>::iterator it;
+        int ncomp;
+        double aexp;
+        long nvalues;
+        long totalRows = 0;
+        int numOutputs = 0;
+
+        // an empty projection would keep all datasets
+        if (columns.size() == 0) {
+            cout << "ERROR: The field maps need no datasets from the data files, nothing to repack." << endl;
+            return -1;
+        }
+
+        startTime = boost::posix_time::microsec_clock::universal_time();
+
+        cout << "Repacking " << columns.size() << " datasets into " << outFileName << ":";
+        for (it = columns.begin(); it != columns.end(); it++) {
+            cout << " " << *it;
+        }
+        cout << endl;
+        reader->setProjection(vector<string>(columns.begin(), columns.end()));
+
+        H5::H5File out(outFileName, H5F_ACC_TRUNC);
+        out.createGroup("Outputs");
+
+        while (reader->readNextOutput(outputName, nvalues)) {
+            groupName = outputName.substr(0, outputName.rfind('/'));
+
+            H5::Group source(reader->getFileWithDataSet(outputName)->openGroup(groupName));
+            H5::Group target(out.createGroup(groupName));
+            copyAttributes(source, target);
+            H5::Attribute att = source.openAttribute("outputExpansionFactor");
+            att.read(H5::PredType::NATIVE_DOUBLE, &aexp);
+
+            // the reader uses the expansion factor as float
+            H5::Group nodeData(out.createGroup(outputName));
+            for (it = columns.begin(); it != columns.end(); it++) {
+                ncomp = reader->getNumComponents(*it);
+                if (ncomp >= 0) {
+                    writeColumn(nodeData, *it, ncomp, nvalues, (float) aexp);
+                }
+            }
+
+            totalRows += nvalues;
+            numOutputs++;
+        }
+        out.close();
+
+        endTime = boost::posix_time::microsec_clock::universal_time();
+        printf("Repacked %d outputs with %ld rows into %s: %lld ms\n", numOutputs, totalRows, outFileName.c_str(), (long long int) (endTime-startTime).total_milliseconds());
+        fflush(stdout);
+
+        return numOutputs;
+    }
+
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <set>
+
+#include "Galacticus_Reader.h"
+
+#ifndef Galacticus_Galacticus_Repack_h
+#define Galacticus_Galacticus_Repack_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // Writes a copy of the data file(s) with only the datasets needed by
+    // the given field maps, for faster repeated ingests: dataset names
+    // without redshift, large chunks and no (or light) compression, all
+    // files of the reader combined into one (row numbers and thus dbIds
+    // stay the same). Optionally the unit conversions are applied to the
+    // values, such datasets get the attribute unitsConverted = h.
+    class Repacker {
+        private:
+            GalacticusReader *reader;
+            string outFileName;
+            long chunkRows;
+            int deflateLevel;
+            bool convert;
+            set<string> columns;        // datasets to keep
+            set<string> rawColumns;     // datasets used by computed fields, not converted
+
+            void addDependencies(const string field);
+            void copyAttributes(H5::Group &source, H5::Group &target);
+            void writeColumn(H5::Group &group, const string name, int ncomp, long nvalues, double scale);
+
+        public:
+            Repacker();
+            Repacker(GalacticusReader *newReader, string newOutFileName, long newChunkRows, int newDeflateLevel, bool newConvert);
+
+            void addFieldMap(vector<string> dataFileFields);
+            void addRawColumn(const string field);
+            int run();
+    };
+
+}
+
+#endif
@@ -90,6 +90,7 @@ namespace Galacticus {
 
         datafileFields.clear();
         databaseFields.clear();
+        assertions.clear();
 
         char *piece = NULL;
         char linechar[1024] = "";
@@ -128,7 +129,14 @@ namespace Galacticus {
                 dataField.type = type.c_str();
                 databaseFields.push_back(dataField);
 
-                // ignore whatever else may be there after the fields and types are read
+                // further tokens: assert=kind:action for the datafile field,
+                // ignore whatever else may be there
+                while (ss >> name) {
+                    if (name.compare(0, 7, "assert=") == 0) {
+                        assertions.push_back(make_pair(datafileFields.back().name, name.substr(7)));
+                    }
+                }
+
                 ss.str("");
                 ss.clear();
                 line.clear();
@@ -209,6 +217,18 @@ namespace Galacticus {
         return returnSchema;
     }
 
+    vector<pair<string, string> > GalacticusSchemaMapper::getAssertions() {
+        return assertions;
+    }
+
+    vector<string> GalacticusSchemaMapper::getDataFileFieldNames() {
+        vector<string> names;
+        for (size_t j=0; j<datafileFields.size(); j++) {
+            names.push_back(datafileFields[j].name);
+        }
+        return names;
+    }
+
     DBType GalacticusSchemaMapper::getDBType(string thisDBType) {
         
         if (thisDBType == "CHAR") {
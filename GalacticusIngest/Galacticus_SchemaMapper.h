@@ -62,6 +62,9 @@ namespace Galacticus {
 
         std::vector<DataField> datafileFields, databaseFields;
 
+        // (datafile field, assertion spec) as given in the mapping file
+        std::vector<std::pair<std::string, std::string> > assertions;
+
         
     public:
         GalacticusSchemaMapper();
@@ -72,6 +75,9 @@ namespace Galacticus {
         
         void readMappingFile(std::string mapFile);
 
+        std::vector<std::pair<std::string, std::string> > getAssertions();
+        std::vector<std::string> getDataFileFieldNames();
+
         DBType getDBType(std::string thisDBType);
 
         DBDataSchema::Schema * generateSchema(std::string dbName, std::string tblName);
@@ -0,0 +1,346 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits>
+
+#include "Galacticus_Stats.h"
+
+// logarithmic histogram: NSUB bins for each power of 2 between 2^MINEXP and 2^MAXEXP,
+// for positive and negative values, plus one bin for 0
+#define STATS_MINEXP -128
+#define STATS_MAXEXP 128
+#define STATS_NSUB 8
+#define STATS_NBINS ((STATS_MAXEXP - STATS_MINEXP) * STATS_NSUB)
+
+static const int numQuantiles = 7;
+static const double quantileLevels[numQuantiles] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+static const char *quantileNames[numQuantiles] = {"p01", "p05", "p25", "p50", "p75", "p95", "p99"};
+
+namespace Galacticus {
+
+    ColumnStats::ColumnStats() {
+        name = "";
+        count = 0;
+        nulls = 0;
+        nans = 0;
+        infs = 0;
+        min = numeric_limits<double>::infinity();
+        max = -numeric_limits<double>::infinity();
+        sum = 0;
+    }
+
+    ColumnStats::ColumnStats(string newName) {
+        name = newName;
+        count = 0;
+        nulls = 0;
+        nans = 0;
+        infs = 0;
+        min = numeric_limits<double>::infinity();
+        max = -numeric_limits<double>::infinity();
+        sum = 0;
+    }
+
+    void ColumnStats::addNull() {
+        nulls++;
+    }
+
+    void ColumnStats::addValue(double v) {
+        // count is the number of non-null values, NaN and Inf are
+        // counted, but not used for min, max, sum and histogram
+        int bin;
+        int e;
+        double m;
+
+        count++;
+        if (v != v) {
+            nans++;
+            return;
+        }
+        if (v == numeric_limits<double>::infinity() || v == -numeric_limits<double>::infinity()) {
+            infs++;
+            return;
+        }
+
+        if (v < min) min = v;
+        if (v > max) max = v;
+        sum += v;
+
+        if (histogram.size() == 0) {
+            histogram.resize(2*STATS_NBINS + 1, 0);
+        }
+
+        if (v == 0) {
+            histogram[STATS_NBINS]++;
+            return;
+        }
+
+        // v = m * 2^e with 0.5 <= |m| < 1
+        m = frexp(fabs(v), &e);
+        if (e < STATS_MINEXP) {
+            e = STATS_MINEXP;
+            m = 0.5;
+        } else if (e >= STATS_MAXEXP) {
+            e = STATS_MAXEXP - 1;
+            m = 0.99;
+        }
+        bin = (e - STATS_MINEXP) * STATS_NSUB + (int) ((m - 0.5) * 2 * STATS_NSUB);
+
+        if (v > 0) {
+            histogram[STATS_NBINS + 1 + bin]++;
+        } else {
+            histogram[STATS_NBINS - 1 - bin]++;
+        }
+    }
+
+    double ColumnStats::getBinLower(int bin) {
+        // lower limit of a histogram bin (bin index as used in histogram vector)
+        int b;
+        if (bin == STATS_NBINS) {
+            return 0;
+        }
+        if (bin > STATS_NBINS) {
+            b = bin - STATS_NBINS - 1;
+            return ldexp(0.5 + 0.5 * (b % STATS_NSUB) / STATS_NSUB, b / STATS_NSUB + STATS_MINEXP);
+        }
+        b = STATS_NBINS - 1 - bin;
+        return -ldexp(0.5 + 0.5 * (b % STATS_NSUB + 1) / STATS_NSUB, b / STATS_NSUB + STATS_MINEXP);
+    }
+
+    double ColumnStats::getBinUpper(int bin) {
+        int b;
+        if (bin == STATS_NBINS) {
+            return 0;
+        }
+        if (bin > STATS_NBINS) {
+            b = bin - STATS_NBINS - 1;
+            return ldexp(0.5 + 0.5 * (b % STATS_NSUB + 1) / STATS_NSUB, b / STATS_NSUB + STATS_MINEXP);
+        }
+        b = STATS_NBINS - 1 - bin;
+        return -ldexp(0.5 + 0.5 * (b % STATS_NSUB) / STATS_NSUB, b / STATS_NSUB + STATS_MINEXP);
+    }
+
+    double ColumnStats::getQuantile(double q) {
+        // interpolate linearly inside the bin that contains the quantile,
+        // restricted to the real min/max values
+        long nfinite = count - nans - infs;
+        double target;
+        double cumulative = 0;
+        double lower;
+        double upper;
+
+        if (nfinite <= 0 || histogram.size() == 0) {
+            return numeric_limits<double>::quiet_NaN();
+        }
+
+        target = q * nfinite;
+        for (size_t bin=0; bin<histogram.size(); bin++) {
+            if (histogram[bin] == 0) {
+                continue;
+            }
+            if (cumulative + histogram[bin] >= target) {
+                lower = getBinLower(bin);
+                upper = getBinUpper(bin);
+                if (lower < min) lower = min;
+                if (upper > max) upper = max;
+                return lower + (upper - lower) * (target - cumulative) / histogram[bin];
+            }
+            cumulative += histogram[bin];
+        }
+        return max;
+    }
+
+    void ColumnStats::finish() {
+        // compute quantiles and keep only the non-empty histogram bins
+        quantiles.clear();
+        for (int i=0; i<numQuantiles; i++) {
+            quantiles.push_back(getQuantile(quantileLevels[i]));
+        }
+
+        sparseBins.clear();
+        sparseCounts.clear();
+        for (size_t bin=0; bin<histogram.size(); bin++) {
+            if (histogram[bin] > 0) {
+                sparseBins.push_back(bin);
+                sparseCounts.push_back(histogram[bin]);
+            }
+        }
+        vector<long>().swap(histogram);
+    }
+
+
+    StatsCollector::StatsCollector() {
+        statsFile = "";
+        current_snapnum = -1;
+        written = false;
+    }
+
+    StatsCollector::StatsCollector(string newStatsFile, string newDataFileName, int newFileNum) {
+        statsFile = newStatsFile;
+        dataFileName = newDataFileName;
+        fileNum = newFileNum;
+        current_snapnum = -1;
+        written = false;
+    }
+
+    StatsCollector::~StatsCollector() {
+        if (!written) {
+            writeReport();
+        }
+    }
+
+    int StatsCollector::getIndex(DBDataSchema::DataObjDesc *item) {
+        int i = items.find(item);
+        if (i >= 0) {
+            return i;
+        }
+
+        // new column
+        current.push_back(ColumnStats(item->getDataObjName()));
+        return items.add(item);
+    }
+
+    void StatsCollector::addValue(DBDataSchema::DataObjDesc *item, int snapnum, bool isNull, void *value) {
+        if (snapnum != current_snapnum) {
+            finishSnapnum();
+            current_snapnum = snapnum;
+        }
+
+        int i = getIndex(item);
+        if (isNull) {
+            current[i].addNull();
+        } else {
+            current[i].addValue(getValueAsDouble(item->getDataObjDType(), value));
+        }
+    }
+
+    void StatsCollector::finishSnapnum() {
+        if (current_snapnum < 0 || current.size() == 0) {
+            return;
+        }
+
+        vector<ColumnStats> &r = results[current_snapnum];
+        for (size_t i=0; i<current.size(); i++) {
+            current[i].finish();
+            r.push_back(current[i]);
+            current[i] = ColumnStats(current[i].name);
+        }
+    }
+
+    static void writeJSONNumber(ofstream &out, double v) {
+        // JSON has no NaN or Inf
+        if (v != v || v == numeric_limits<double>::infinity() || v == -numeric_limits<double>::infinity()) {
+            out << "null";
+        } else {
+            out << v;
+        }
+    }
+
+    void StatsCollector::writeReport() {
+        ofstream out;
+
+        finishSnapnum();
+        current_snapnum = -1;
+        written = true;
+
+        out.open(statsFile.c_str(), ios::out | ios::trunc);
+        if (!out) {
+            cout << "ERROR: Cannot write statistics to file " << statsFile << endl;
+            return;
+        }
+
+        out.precision(10);
+        out << "{" << endl;
+        out << "  \"dataFile\": \"" << dataFileName << "\"," << endl;
+        out << "  \"fileNum\": " << fileNum << "," << endl;
+        out << "  \"snapnums\": [";
+
+        for (map<int, vector<ColumnStats> >::iterator it = results.begin(); it != results.end(); it++) {
+            if (it != results.begin()) {
+                out << ",";
+            }
+            out << endl << "    {\"snapnum\": " << it->first << ", \"columns\": [";
+            for (size_t i=0; i<it->second.size(); i++) {
+                ColumnStats &c = it->second[i];
+                if (i > 0) {
+                    out << ",";
+                }
+                out << endl << "      {\"name\": \"" << c.name << "\"";
+                out << ", \"count\": " << c.count << ", \"nulls\": " << c.nulls;
+                out << ", \"nans\": " << c.nans << ", \"infs\": " << c.infs;
+                out << ", \"min\": ";
+                writeJSONNumber(out, c.min);
+                out << ", \"max\": ";
+                writeJSONNumber(out, c.max);
+                out << ", \"sum\": ";
+                writeJSONNumber(out, c.sum);
+                for (size_t q=0; q<c.quantiles.size(); q++) {
+                    out << ", \"" << quantileNames[q] << "\": ";
+                    writeJSONNumber(out, c.quantiles[q]);
+                }
+                out << "," << endl << "       \"histogram\": [";
+                for (size_t b=0; b<c.sparseBins.size(); b++) {
+                    if (b > 0) {
+                        out << ", ";
+                    }
+                    out << "[" << ColumnStats::getBinLower(c.sparseBins[b]) << ", " << ColumnStats::getBinUpper(c.sparseBins[b]) << ", " << c.sparseCounts[b] << "]";
+                }
+                out << "]}";
+            }
+            out << "]}";
+        }
+
+        out << endl << "  ]" << endl << "}" << endl;
+        out.close();
+
+        cout << "Column statistics written to " << statsFile << endl;
+    }
+
+    double getValueAsDouble(DBDataSchema::DType dtype, void *value) {
+        switch (dtype) {
+            case DBDataSchema::DT_INT1:
+                return (double) *(char*) value;
+            case DBDataSchema::DT_INT2:
+                return (double) *(short*) value;
+            case DBDataSchema::DT_INT4:
+                return (double) *(int*) value;
+            case DBDataSchema::DT_INT8:
+                return (double) *(long*) value;
+            case DBDataSchema::DT_UINT1:
+                return (double) *(unsigned char*) value;
+            case DBDataSchema::DT_UINT2:
+                return (double) *(unsigned short*) value;
+            case DBDataSchema::DT_UINT4:
+                return (double) *(unsigned int*) value;
+            case DBDataSchema::DT_UINT8:
+                return (double) *(unsigned long*) value;
+            case DBDataSchema::DT_REAL4:
+                return (double) *(float*) value;
+            case DBDataSchema::DT_REAL8:
+                return *(double*) value;
+            default:
+                return numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+}
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <DataObjDesc.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Galacticus_ItemIndex.h"
+
+#ifndef Galacticus_Galacticus_Stats_h
+#define Galacticus_Galacticus_Stats_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // streaming statistics of one column for one snapnum; the histogram
+    // uses logarithmic bins (8 per factor of 2), so it needs no value range
+    // in advance and gives approximate quantiles with ~10% relative error
+    class ColumnStats {
+        public:
+            string name;
+            long count;
+            long nulls;
+            long nans;
+            long infs;
+            double min;
+            double max;
+            double sum;
+            vector<long> histogram;
+
+            // filled by finish(), the full histogram is dropped then
+            vector<double> quantiles;
+            vector<int> sparseBins;
+            vector<long> sparseCounts;
+
+            ColumnStats();
+            ColumnStats(string newName);
+
+            void addValue(double v);
+            void addNull();
+            double getQuantile(double q);
+            void finish();
+            static double getBinLower(int bin);
+            static double getBinUpper(int bin);
+    };
+
+
+    // collects statistics of all ingested values per snapnum and column,
+    // i.e. of what ends up in the database, and writes them as JSON report
+    class StatsCollector {
+        private:
+            string statsFile;
+            string dataFileName;
+            int fileNum;
+
+            ItemIndex items;
+
+            int current_snapnum;
+            vector<ColumnStats> current;
+            map<int, vector<ColumnStats> > results;
+            bool written;
+
+            int getIndex(DBDataSchema::DataObjDesc *item);
+            void finishSnapnum();
+
+        public:
+            StatsCollector();
+            StatsCollector(string newStatsFile, string newDataFileName, int newFileNum);
+            ~StatsCollector();
+
+            void addValue(DBDataSchema::DataObjDesc *item, int snapnum, bool isNull, void *value);
+            void writeReport();
+    };
+
+    double getValueAsDouble(DBDataSchema::DType dtype, void *value);
+
+}
+
+#endif
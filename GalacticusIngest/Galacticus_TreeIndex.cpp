@@ -0,0 +1,197 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+
+#include "Galacticus_TreeIndex.h"
+
+namespace Galacticus {
+
+    NodeHash::NodeHash() {
+        mask = 0;
+    }
+
+    unsigned long NodeHash::hash(long key) {
+        // mix the bits, node indices are often consecutive numbers
+        unsigned long h = (unsigned long) key;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdUL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53UL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    void NodeHash::build(const long *nodeIndex, long nvalues) {
+        // table size: power of 2, at most half full;
+        // for duplicate node indices the first row is kept
+        unsigned long size = 16;
+        unsigned long slot;
+
+        while (size < 2 * (unsigned long) nvalues) {
+            size *= 2;
+        }
+        mask = size - 1;
+        keys.assign(size, 0);
+        rows.assign(size, -1);
+
+        for (long i=0; i<nvalues; i++) {
+            slot = hash(nodeIndex[i]) & mask;
+            while (rows[slot] >= 0 && keys[slot] != nodeIndex[i]) {
+                slot = (slot + 1) & mask;
+            }
+            if (rows[slot] < 0) {
+                keys[slot] = nodeIndex[i];
+                rows[slot] = i;
+            }
+        }
+    }
+
+    long NodeHash::find(long key) const {
+        // row of the given node index, -1 if not found
+        if (rows.size() == 0) {
+            return -1;
+        }
+        unsigned long slot = hash(key) & mask;
+        while (rows[slot] >= 0) {
+            if (keys[slot] == key) {
+                return rows[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        return -1;
+    }
+
+    void NodeHash::clear() {
+        vector<long>().swap(keys);
+        vector<long>().swap(rows);
+        mask = 0;
+    }
+
+    bool NodeHash::isEmpty() const {
+        return (rows.size() == 0);
+    }
+
+
+    TreeIndex::TreeIndex() {
+        built = false;
+    }
+
+    void TreeIndex::build(const long *nodeIndex, const long *parentIndex, long nvalues) {
+        // linear in the number of nodes: hash lookup of all parents,
+        // children lists in compressed form (offsets + one array) and
+        // a depth-first traversal with an explicit stack
+        vector<long> childStart(nvalues + 1, 0);
+        vector<long> children(nvalues);
+        vector<long> stack(nvalues + 1);
+        long nstack;
+        long pos = 0;
+        long rootPos;
+        long row;
+        long p;
+
+        // the hash may exist already (e.g. for derived columns)
+        if (nodeHash.isEmpty()) {
+            nodeHash.build(nodeIndex, nvalues);
+        }
+
+        parentRow.resize(nvalues);
+        for (long i=0; i<nvalues; i++) {
+            p = nodeHash.find(parentIndex[i]);
+            if (p == i) {
+                p = -1;
+            }
+            parentRow[i] = p;
+            if (p >= 0) {
+                childStart[p+1]++;
+            }
+        }
+
+        for (long i=0; i<nvalues; i++) {
+            childStart[i+1] += childStart[i];
+        }
+        // fill children in row order, using stack as insert position for now
+        for (long i=0; i<nvalues; i++) {
+            stack[i] = childStart[i];
+        }
+        for (long i=0; i<nvalues; i++) {
+            if (parentRow[i] >= 0) {
+                children[stack[parentRow[i]]++] = i;
+            }
+        }
+
+        depthFirst.assign(nvalues, -1);
+        forestRoot.resize(nvalues);
+
+        // roots first, in row order; rows still left afterwards belong to
+        // parent cycles (broken data) and are started from as well
+        for (int pass=0; pass<2; pass++) {
+            for (long r=0; r<nvalues; r++) {
+                if (depthFirst[r] >= 0 || (pass == 0 && parentRow[r] >= 0)) {
+                    continue;
+                }
+
+                rootPos = pos;
+                nstack = 0;
+                stack[nstack++] = r;
+                while (nstack > 0) {
+                    row = stack[--nstack];
+                    if (depthFirst[row] >= 0) {
+                        continue;
+                    }
+                    depthFirst[row] = pos++;
+                    forestRoot[row] = rootPos;
+                    // push in reverse order, so that the first child comes next
+                    for (long c=childStart[row+1]-1; c>=childStart[row]; c--) {
+                        if (depthFirst[children[c]] < 0) {
+                            stack[nstack++] = children[c];
+                        }
+                    }
+                }
+            }
+        }
+
+        built = true;
+    }
+
+    void TreeIndex::clear() {
+        vector<long>().swap(parentRow);
+        vector<long>().swap(depthFirst);
+        vector<long>().swap(forestRoot);
+        nodeHash.clear();
+        built = false;
+    }
+
+    bool TreeIndex::isBuilt() const {
+        return built;
+    }
+
+    long TreeIndex::getParentRow(long row) const {
+        return parentRow[row];
+    }
+
+    long TreeIndex::getDepthFirstId(long row) const {
+        return depthFirst[row];
+    }
+
+    long TreeIndex::getForestId(long row) const {
+        return forestRoot[row];
+    }
+
+}
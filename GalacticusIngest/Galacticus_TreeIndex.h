@@ -0,0 +1,76 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <vector>
+
+#ifndef Galacticus_Galacticus_TreeIndex_h
+#define Galacticus_Galacticus_TreeIndex_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // open-addressing hash table (linear probing) from node index to row
+    // number inside one output; all memory is allocated once in build()
+    class NodeHash {
+        private:
+            vector<long> keys;
+            vector<long> rows;  // -1 = empty slot
+            unsigned long mask;
+
+            static unsigned long hash(long key);
+
+        public:
+            NodeHash();
+
+            void build(const long *nodeIndex, long nvalues);
+            long find(long key) const;
+            void clear();
+            bool isEmpty() const;
+    };
+
+
+    // forests of one output, built from nodeIndex and parentIndex: the rows
+    // are numbered in depth-first order (children in row order), so that
+    // each subtree gets a contiguous range of numbers; the forest is
+    // identified by the number of its root
+    class TreeIndex {
+        private:
+            bool built;
+            vector<long> parentRow;     // -1 for roots
+            vector<long> depthFirst;    // position of each row in depth-first order
+            vector<long> forestRoot;    // depth-first position of the root of each row
+
+        public:
+            NodeHash nodeHash;
+
+            TreeIndex();
+
+            void build(const long *nodeIndex, const long *parentIndex, long nvalues);
+            void clear();
+            bool isBuilt() const;
+
+            long getParentRow(long row) const;
+            long getDepthFirstId(long row) const;
+            long getForestId(long row) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+#include "Galacticus_WorkQueue.h"
+
+namespace Galacticus {
+
+    // sorted names of all files in a directory
+    static vector<string> listDirectory(const string dir) {
+        vector<string> names;
+        boost::filesystem::directory_iterator end;
+        for (boost::filesystem::directory_iterator it(dir); it != end; it++) {
+            names.push_back(it->path().filename().string());
+        }
+        sort(names.begin(), names.end());
+        return names;
+    }
+
+    WorkQueue::WorkQueue(string newQueueDir, int newLeaseTimeout, int newMaxAttempts) {
+        char host[256];
+
+        queueDir = newQueueDir;
+        leaseTimeout = newLeaseTimeout;
+        if (leaseTimeout < 3) {
+            leaseTimeout = 3;
+        }
+        maxAttempts = newMaxAttempts;
+        if (maxAttempts < 1) {
+            maxAttempts = 1;
+        }
+
+        if (gethostname(host, sizeof(host)) != 0) {
+            strcpy(host, "localhost");
+        }
+        host[sizeof(host)-1] = '\0';
+        stringstream ss;
+        ss << host << "_" << getpid();
+        owner = ss.str();
+
+        leaseFile = "";
+        leaseLost = false;
+        working = false;
+    }
+
+    string WorkQueue::getUnitName(int fileNum, int snapnum) {
+        // sorts by file, then snapnum
+        char name[100];
+        sprintf(name, "f%06d_s%04d", fileNum, snapnum);
+        return string(name);
+    }
+
+    int WorkQueue::init(vector<string> dataFiles, int firstFileNum, vector<int> snapnums) {
+        // one unit per data file and snapnum; units that exist already
+        // (in any state) are kept, so new files can be added later on
+        string unit;
+        string tmpFile;
+        long numAdded = 0;
+        vector<int> empty;
+
+        boost::filesystem::create_directories(queueDir + string("/todo"));
+        boost::filesystem::create_directories(queueDir + string("/claimed"));
+        boost::filesystem::create_directories(queueDir + string("/done"));
+        boost::filesystem::create_directories(queueDir + string("/failed"));
+
+        vector<string> claimed = listDirectory(queueDir + string("/claimed"));
+
+        for (size_t f=0; f<dataFiles.size(); f++) {
+            int fileNum = firstFileNum + f;
+            GalacticusReader reader(dataFiles[f], fileNum, empty, 1.);
+            vector<int> fileSnapnums = reader.getSnapnums();
+
+            for (size_t i=0; i<fileSnapnums.size(); i++) {
+                if (snapnums.size() > 0 && find(snapnums.begin(), snapnums.end(), fileSnapnums[i]) == snapnums.end()) {
+                    continue;
+                }
+                unit = getUnitName(fileNum, fileSnapnums[i]);
+
+                bool exists = boost::filesystem::exists(queueDir + string("/todo/") + unit)
+                    || boost::filesystem::exists(queueDir + string("/done/") + unit)
+                    || boost::filesystem::exists(queueDir + string("/failed/") + unit);
+                for (size_t c=0; c<claimed.size(); c++) {
+                    if (claimed[c].substr(0, claimed[c].find('@')) == unit) {
+                        exists = true;
+                    }
+                }
+                if (exists) {
+                    continue;
+                }
+
+                // write to a temporary file first, so that no one claims a half-written unit
+                tmpFile = queueDir + string("/") + unit + string(".") + owner + string(".tmp");
+                ofstream out(tmpFile.c_str());
+                out << fileNum << " " << fileSnapnums[i] << endl;
+                out << boost::filesystem::absolute(dataFiles[f]).string() << endl;
+                out.close();
+                if (!out || rename(tmpFile.c_str(), (queueDir + string("/todo/") + unit).c_str()) != 0) {
+                    cout << "ERROR: Cannot add work unit " << unit << " to queue " << queueDir << endl;
+                    return EXIT_FAILURE;
+                }
+                numAdded++;
+            }
+        }
+
+        cout << "Added " << numAdded << " work units to queue " << queueDir << endl;
+        return EXIT_SUCCESS;
+    }
+
+    bool WorkQueue::claimUnit(string &unit, string &claimedFile) {
+        vector<string> todo = listDirectory(queueDir + string("/todo"));
+        for (size_t i=0; i<todo.size(); i++) {
+            claimedFile = queueDir + string("/claimed/") + todo[i] + string("@") + owner;
+            if (rename((queueDir + string("/todo/") + todo[i]).c_str(), claimedFile.c_str()) == 0) {
+                unit = todo[i];
+                return true;
+            }
+            // someone else was faster
+        }
+        return false;
+    }
+
+    bool WorkQueue::stealUnit(string &unit, string &claimedFile, long &numFailed) {
+        // take over a unit whose lease has expired; the claimed file name
+        // counts the attempts (<unit>@<owner>#<n> from the second one on),
+        // a unit that was given up maxAttempts times (e.g. because reading
+        // it crashed each process) is moved to failed/
+        vector<string> claimed = listDirectory(queueDir + string("/claimed"));
+        string oldFile;
+        string oldOwner;
+        string::size_type pos;
+        int attempt;
+        time_t now = time(NULL);
+
+        for (size_t i=0; i<claimed.size(); i++) {
+            oldFile = queueDir + string("/claimed/") + claimed[i];
+            if (difftime(now, boost::filesystem::last_write_time(oldFile)) < leaseTimeout) {
+                continue;
+            }
+            unit = claimed[i].substr(0, claimed[i].find('@'));
+            oldOwner = claimed[i].substr(claimed[i].find('@') + 1);
+            attempt = 1;
+            pos = oldOwner.rfind('#');
+            if (pos != string::npos) {
+                attempt = atoi(oldOwner.substr(pos + 1).c_str());
+                oldOwner = oldOwner.substr(0, pos);
+            }
+
+            if (attempt >= maxAttempts) {
+                if (rename(oldFile.c_str(), (queueDir + string("/failed/") + unit).c_str()) == 0) {
+                    cout << "ERROR: Work unit " << unit << " was given up " << attempt << " times (last by " << oldOwner
+                         << "), moving it to failed/; rows it may have ingested already need to be deleted." << endl;
+                    numFailed++;
+                }
+                continue;
+            }
+
+            stringstream ss;
+            ss << queueDir << "/claimed/" << unit << "@" << owner << "#" << attempt + 1;
+            claimedFile = ss.str();
+            if (rename(oldFile.c_str(), claimedFile.c_str()) == 0) {
+                utime(claimedFile.c_str(), NULL);
+                cout << "WARNING: Taking over work unit " << unit << " from " << oldOwner << " (attempt " << attempt + 1 << " of " << maxAttempts
+                     << "), whose lease has expired; rows it may have ingested already need to be deleted." << endl;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool WorkQueue::readUnit(const string claimedFile, IngestJob &job) {
+        ifstream in(claimedFile.c_str());
+        string dataFile;
+        int snapnum;
+
+        in >> job.fileNum >> snapnum;
+        in.ignore(1);
+        getline(in, dataFile);
+        if (!in || dataFile == "") {
+            return false;
+        }
+        job.dataFiles.push_back(dataFile);
+        job.snapnums.push_back(snapnum);
+        return true;
+    }
+
+    void WorkQueue::renewLease() {
+        // touch the claimed file of the current unit regularly
+        boost::mutex::scoped_lock lock(mutex);
+        while (working) {
+            if (leaseFile != "" && utime(leaseFile.c_str(), NULL) != 0 && !leaseLost) {
+                cout << "WARNING: Lost the lease of " << leaseFile << ", the unit may be ingested twice." << endl;
+                leaseLost = true;
+            }
+            leaseDone.timed_wait(lock, boost::posix_time::seconds(leaseTimeout / 3));
+        }
+    }
+
+    int WorkQueue::work(IngestSettings settings, string whereExpr) {
+        // claim and ingest units until none are left, neither in todo
+        // nor claimed by other processes (which may still crash)
+        boost::mutex statusMutex;
+        IngestWorker ingestWorker(settings.system, &statusMutex);
+        string unit;
+        string claimedFile;
+        string target;
+        long numUnits = 0;
+        long numFailed = 0;
+        long totalRows = 0;
+        int waitSeconds = (leaseTimeout / 4 < 10) ? leaseTimeout / 4 : 10;
+        if (waitSeconds < 1) {
+            waitSeconds = 1;
+        }
+
+        working = true;
+        boost::thread leaseThread(boost::bind(&WorkQueue::renewLease, this));
+
+        while (true) {
+            if (!claimUnit(unit, claimedFile) && !stealUnit(unit, claimedFile, numFailed)) {
+                if (listDirectory(queueDir + string("/claimed")).size() == 0) {
+                    break;
+                }
+                boost::this_thread::sleep(boost::posix_time::seconds(waitSeconds));
+                continue;
+            }
+
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                leaseFile = claimedFile;
+                leaseLost = false;
+            }
+
+            IngestJob job;
+            job.settings = settings;
+            job.whereExpr = whereExpr;
+            if (readUnit(claimedFile, job)) {
+                cout << "Ingesting work unit " << unit << endl;
+                ingestWorker.runJob(&job);
+            } else {
+                job.state = "failed";
+                job.message = "cannot read work unit";
+            }
+
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                leaseFile = "";
+            }
+
+            target = queueDir + string(job.state == "done" ? "/done/" : "/failed/") + unit;
+            if (rename(claimedFile.c_str(), target.c_str()) != 0) {
+                cout << "WARNING: Work unit " << unit << " was taken over by another process, it may have been ingested twice." << endl;
+            }
+
+            numUnits++;
+            totalRows += job.rows;
+            if (job.state != "done") {
+                numFailed++;
+                cout << "ERROR: Work unit " << unit << " failed: " << job.message << endl;
+            } else {
+                cout << "Work unit " << unit << " done: " << job.rows << " rows" << endl;
+            }
+        }
+
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            working = false;
+        }
+        leaseDone.notify_all();
+        leaseThread.join();
+
+        cout << "Work queue " << queueDir << " is empty: " << numUnits << " units (" << numFailed << " failed), " << totalRows << " rows ingested by " << owner << endl;
+        return (numFailed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "Galacticus_Daemon.h"
+
+#ifndef Galacticus_Galacticus_WorkQueue_h
+#define Galacticus_Galacticus_WorkQueue_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // Work queue in a directory on a shared file system, for running many
+    // ingest processes on several nodes without a scheduler. Each work unit
+    // (one snapnum of one data file) is a small file; it moves from todo/
+    // to claimed/ (with the owner's name appended) to done/, always with an
+    // atomic rename, so each unit is claimed by exactly one process. The
+    // owner touches its claimed file regularly (lease); claimed units whose
+    // lease has expired, e.g. because the process crashed, are taken over by
+    // idle processes when no todo units are left, at most maxAttempts - 1
+    // times; then the unit is moved to failed/.
+    class WorkQueue {
+        private:
+            string queueDir;
+            int leaseTimeout;   // seconds
+            int maxAttempts;    // claims of a unit before it is moved to failed/
+            string owner;       // host name and process id
+
+            boost::mutex mutex;
+            boost::condition_variable leaseDone;
+            string leaseFile;   // claimed file of the current unit, "" = none
+            bool leaseLost;
+            bool working;       // false stops renewing leases
+
+            string getUnitName(int fileNum, int snapnum);
+            bool claimUnit(string &unit, string &claimedFile);
+            bool stealUnit(string &unit, string &claimedFile, long &numFailed);
+            bool readUnit(const string claimedFile, IngestJob &job);
+            void renewLease();
+
+        public:
+            WorkQueue(string newQueueDir, int newLeaseTimeout, int newMaxAttempts);
+
+            int init(vector<string> dataFiles, int firstFileNum, vector<int> snapnums);
+            int work(IngestSettings settings, string whereExpr);
+    };
+
+}
+
+#endif
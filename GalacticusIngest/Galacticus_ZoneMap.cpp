@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits>
+#include <boost/filesystem.hpp>
+
+#include "Galacticus_ZoneMap.h"
+
+namespace Galacticus {
+
+    ZoneMapColumn::ZoneMapColumn() {
+        chunksize = 0;
+        nvalues = 0;
+    }
+
+
+    ZoneMap::ZoneMap() {
+        zoneMapFile = "";
+        signature = "";
+        changed = false;
+    }
+
+    ZoneMap::ZoneMap(vector<string> dataFileNames, string newZoneMapFile) {
+        // default: sidecar file with the same name as the (first) data file
+        zoneMapFile = newZoneMapFile;
+        if (zoneMapFile == "") {
+            zoneMapFile = dataFileNames[0] + string(".zonemap");
+        }
+
+        // zone maps are only valid as long as the data files are not changed
+        stringstream ss;
+        for (size_t f=0; f<dataFileNames.size(); f++) {
+            if (f > 0) {
+                ss << " ";
+            }
+            ss << boost::filesystem::file_size(dataFileNames[f]) << " " << boost::filesystem::last_write_time(dataFileNames[f]);
+        }
+        signature = ss.str();
+        changed = false;
+
+        load();
+    }
+
+    ZoneMap::~ZoneMap() {
+        save();
+    }
+
+    string ZoneMap::getKey(string outputName, string column) {
+        return outputName + string("/") + column;
+    }
+
+    void ZoneMap::load() {
+        // format:
+        // signature <file size> <modification time>   (for each data file)
+        // column <output name>/<column name> <chunksize> <nvalues> <nchunks>
+        // <min> <max>   (one line per chunk)
+        ifstream fileStream;
+        string line;
+        string word;
+        string key;
+        string vmin;
+        string vmax;
+        long nchunks;
+
+        columns.clear();
+
+        fileStream.open(zoneMapFile.c_str(), ios::in);
+        if (!fileStream) {
+            return; // no zone maps yet
+        }
+
+        getline(fileStream, line);
+        if (line != string("signature ") + signature) {
+            cout << "Zone map file " << zoneMapFile << " does not match the data file, zone maps will be recomputed." << endl;
+            fileStream.close();
+            return;
+        }
+
+        while (fileStream >> word) {
+            if (word != "column") {
+                cout << "ERROR: Unexpected entry '" << word << "' in zone map file " << zoneMapFile << ", zone maps will be recomputed." << endl;
+                columns.clear();
+                break;
+            }
+            ZoneMapColumn z;
+            fileStream >> key >> z.chunksize >> z.nvalues >> nchunks;
+            z.minval.resize(nchunks);
+            z.maxval.resize(nchunks);
+            for (long c=0; c<nchunks; c++) {
+                // use strtod, since streams cannot read inf
+                fileStream >> vmin >> vmax;
+                z.minval[c] = strtod(vmin.c_str(), NULL);
+                z.maxval[c] = strtod(vmax.c_str(), NULL);
+            }
+            columns[key] = z;
+        }
+
+        fileStream.close();
+        cout << "Read zone maps for " << columns.size() << " columns from " << zoneMapFile << endl;
+    }
+
+    void ZoneMap::save() {
+        if (!changed) {
+            return;
+        }
+
+        ofstream fileStream;
+        fileStream.open(zoneMapFile.c_str(), ios::out | ios::trunc);
+        if (!fileStream) {
+            cout << "WARNING: Cannot write zone map file " << zoneMapFile << endl;
+            return;
+        }
+
+        fileStream.precision(17);
+        fileStream << "signature " << signature << endl;
+        for (map<string, ZoneMapColumn>::iterator it = columns.begin(); it != columns.end(); it++) {
+            ZoneMapColumn &z = it->second;
+            fileStream << "column " << it->first << " " << z.chunksize << " " << z.nvalues << " " << z.minval.size() << endl;
+            for (size_t c=0; c<z.minval.size(); c++) {
+                fileStream << z.minval[c] << " " << z.maxval[c] << endl;
+            }
+        }
+        fileStream.close();
+
+        changed = false;
+    }
+
+    bool ZoneMap::hasColumn(string outputName, string column) {
+        return (columns.find(getKey(outputName, column)) != columns.end());
+    }
+
+    ZoneMapColumn & ZoneMap::getColumn(string outputName, string column) {
+        return columns[getKey(outputName, column)];
+    }
+
+    void ZoneMap::computeColumn(string outputName, string column, double *doubleval, long *longval, long nvalues, long chunksize) {
+        // NaN values are ignored, a chunk with only NaNs gets
+        // min > max and therefore never matches any range
+        ZoneMapColumn z;
+        long nchunks = (nvalues + chunksize - 1) / chunksize;
+        double v;
+        double vmin;
+        double vmax;
+        long end;
+
+        z.chunksize = chunksize;
+        z.nvalues = nvalues;
+        z.minval.resize(nchunks);
+        z.maxval.resize(nchunks);
+
+        for (long c=0; c<nchunks; c++) {
+            vmin = numeric_limits<double>::infinity();
+            vmax = -numeric_limits<double>::infinity();
+            end = (c+1) * chunksize;
+            if (end > nvalues) {
+                end = nvalues;
+            }
+            if (doubleval) {
+                for (long i=c*chunksize; i<end; i++) {
+                    v = doubleval[i];
+                    if (v < vmin) vmin = v;
+                    if (v > vmax) vmax = v;
+                }
+            } else {
+                for (long i=c*chunksize; i<end; i++) {
+                    v = (double) longval[i];
+                    if (v < vmin) vmin = v;
+                    if (v > vmax) vmax = v;
+                }
+            }
+            z.minval[c] = vmin;
+            z.maxval[c] = vmax;
+        }
+
+        columns[getKey(outputName, column)] = z;
+        changed = true;
+    }
+
+}
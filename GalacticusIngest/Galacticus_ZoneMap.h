@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifndef Galacticus_Galacticus_ZoneMap_h
+#define Galacticus_Galacticus_ZoneMap_h
+
+using namespace std;
+
+namespace Galacticus {
+
+    // minimum and maximum value of one column for each chunk of rows
+    class ZoneMapColumn {
+        public:
+            long chunksize;
+            long nvalues;
+            vector<double> minval;
+            vector<double> maxval;
+
+            ZoneMapColumn();
+    };
+
+
+    // Zone maps for columns of one data file, kept in a sidecar file next
+    // to the data file, so that they need to be computed only once (when the
+    // column is read completely for the first time). They are used for
+    // skipping all chunks whose value range cannot match a requested range.
+    class ZoneMap {
+        private:
+            string zoneMapFile;
+            string signature; // size and modification time of the data file
+            map<string, ZoneMapColumn> columns; // key: output name + "/" + column name
+            bool changed;
+
+            string getKey(string outputName, string column);
+
+        public:
+            ZoneMap();
+            ZoneMap(vector<string> dataFileNames, string newZoneMapFile);
+            ~ZoneMap();
+
+            void load();
+            void save();
+
+            bool hasColumn(string outputName, string column);
+            ZoneMapColumn & getColumn(string outputName, string column);
+
+            void computeColumn(string outputName, string column, double *doubleval, long *longval, long nvalues, long chunksize);
+    };
+
+}
+
+#endif
@@ -23,6 +23,13 @@
 #include <iostream>
 #include "Galacticus_Reader.h"
 #include "Galacticus_SchemaMapper.h"
+#include "Galacticus_BatchTuner.h"
+#include "Galacticus_Pipeline.h"
+#include "Galacticus_History.h"
+#include "Galacticus_Daemon.h"
+#include "Galacticus_WorkQueue.h"
+#include "Galacticus_FanOut.h"
+#include "Galacticus_Repack.h"
 #include "galacticusingest_error.h"
 #include <Schema.h>
 #include <DBIngestor.h>
@@ -30,18 +37,143 @@
 #include <AsserterFactory.h>
 #include <ConverterFactory.h>
 #include <boost/program_options.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <sstream>
+#include <fstream>
 #include <vector>
 
 using namespace Galacticus;
 using namespace std;
 namespace po = boost::program_options;
 
+// ingest in segments of tuneBatches batches each, and adjust the
+// buffer size after each segment according to the measured rate
+template <class SegmentReader>
+void ingestAutoTuned(DBIngest::DBIngestor *ingestor, SegmentReader *reader, BatchTuner &tuner) {
+    boost::posix_time::ptime startTime;
+    boost::posix_time::ptime endTime;
+
+    while (!reader->isFinished()) {
+        reader->setSegmentRows(tuner.getSegmentRows());
+        reader->startSegment();
+
+        startTime = boost::posix_time::microsec_clock::universal_time();
+        ingestor->ingestData(tuner.getBufferSize());
+        endTime = boost::posix_time::microsec_clock::universal_time();
+
+        tuner.update(reader->getRowsInSegment(), (endTime-startTime).total_microseconds() / 1.e6);
+
+        // the schema needs to be validated only once
+        ingestor->setAskUserToValidateRead(false);
+    }
+    tuner.printSummary();
+}
+
+// read the rows once and insert them into several tables: the one given
+// by -f and -T, one per --target (fieldmap:table) and one per --route
+// (table:condition, with the field map of -f), each with its own database
+// connection; with routes, the -T table only gets the rows of no route;
+// returns the number of failed tables
+int ingestFanOut(GalacticusReader *reader, DBDataSchema::Schema *firstSchema, const IngestSettings &settings, vector<string> &targetSpecs,
+                 vector<string> &routeSpecs, DBAsserter::AsserterFactory *assertFac, DBConverter::ConverterFactory *convFac,
+                 int queueBatches, long batchRows) {
+    DBServer::DBAdaptorsFactory adaptorFac;
+    FanOut fanOut(reader, queueBatches, batchRows);
+    vector<GalacticusSchemaMapper*> mappers;
+    vector<DBDataSchema::Schema*> schemas;
+    vector<string> names;
+    vector<unsigned long> routeMasks;
+    vector<FanOutReader*> readers;
+    vector<DBServer::DBAbstractor*> servers;
+    vector<DBIngest::DBIngestor*> ingestors;
+    int numFailed;
+
+    schemas.push_back(firstSchema);
+    names.push_back(settings.table);
+    routeMasks.push_back(0);
+    for (size_t i=0; i<targetSpecs.size(); i++) {
+        string::size_type pos = targetSpecs[i].rfind(':');
+        if (pos == string::npos || pos == 0 || pos == targetSpecs[i].length() - 1) {
+            cout << "ERROR: Target " << targetSpecs[i] << " must be given as fieldmap:table." << endl;
+            return targetSpecs.size() + routeSpecs.size() + 1;
+        }
+        cout << "Mapping file: " << targetSpecs[i].substr(0, pos) << " for table " << targetSpecs[i].substr(pos + 1) << endl;
+        mappers.push_back(new GalacticusSchemaMapper(assertFac, convFac));
+        mappers.back()->readMappingFile(targetSpecs[i].substr(0, pos));
+        schemas.push_back(mappers.back()->generateSchema(settings.dbase, targetSpecs[i].substr(pos + 1)));
+        names.push_back(targetSpecs[i].substr(pos + 1));
+        routeMasks.push_back(0);
+    }
+    for (size_t i=0; i<routeSpecs.size(); i++) {
+        string::size_type pos = routeSpecs[i].find(':');
+        if (pos == string::npos || pos == 0 || pos == routeSpecs[i].length() - 1) {
+            cout << "ERROR: Route " << routeSpecs[i] << " must be given as table:condition." << endl;
+            return targetSpecs.size() + routeSpecs.size() + 1;
+        }
+        cout << "Route: rows with " << routeSpecs[i].substr(pos + 1) << " into table " << routeSpecs[i].substr(0, pos) << endl;
+        routeMasks.push_back(1UL << reader->addRoute(routeSpecs[i].substr(pos + 1)));
+        mappers.push_back(new GalacticusSchemaMapper(assertFac, convFac));
+        mappers.back()->readMappingFile(settings.mapFile);
+        schemas.push_back(mappers.back()->generateSchema(settings.dbase, routeSpecs[i].substr(0, pos)));
+        names.push_back(routeSpecs[i].substr(0, pos));
+    }
+
+    for (size_t t=0; t<schemas.size(); t++) {
+        readers.push_back(new FanOutReader(&fanOut, names[t], schemas[t]));
+        readers[t]->setRoute(routeMasks[t], (t == 0 && routeSpecs.size() > 0));
+        servers.push_back(adaptorFac.getDBAdaptors(settings.system));
+        ingestors.push_back(new DBIngest::DBIngestor(schemas[t], readers[t], servers[t]));
+        applyConnectionSettings(ingestors[t], settings);
+        ingestors[t]->setResumeMode(settings.resumeMode);
+        ingestors[t]->setIsDryRun(settings.isDryRun);
+        // the ingestors run in parallel, so nobody can be asked
+        ingestors[t]->setAskUserToValidateRead(false);
+        ingestors[t]->setPerformanceMeter(settings.outputFreq);
+    }
+
+    cout << "Ingesting into " << schemas.size() << " tables, " << fanOut.getNumSlots() << " items are read once per row" << endl;
+    numFailed = fanOut.run(ingestors, settings.bufferSize);
+
+    for (size_t t=0; t<schemas.size(); t++) {
+        delete ingestors[t];
+        delete readers[t];
+        delete servers[t];
+        if (t > 0) {
+            delete schemas[t];
+            delete mappers[t-1];
+        }
+    }
+
+    return numFailed;
+}
+
+
+// options of a single ingest run that are not passed on to the jobs of a
+// work queue or a daemon (which also has its own where= per job)
+static const char *queueIgnoredOptions[] = {"range", "zoneMapFile", "sample", "partition", "sortBy", "history", "statsFile",
+                                            "checksumFile", "aggregate", "manifest", "pipeline", "autoTune", "target", "route",
+                                            "follow", "repack", NULL};
+
+// comma-separated list of the given options (i.e. not just defaults) out of names
+string getGivenOptions(po::variables_map &varMap, const char **names) {
+    string given;
+    for (int i=0; names[i]; i++) {
+        if (varMap.count(names[i]) && !varMap[names[i]].defaulted()) {
+            if (given != "") {
+                given += ", ";
+            }
+            given += string("--") + names[i];
+        }
+    }
+    return given;
+}
 
 int main (int argc, const char * argv[])
 {
-    string dataFile;
+    vector<string> dataFiles;
+    // optional file with the names of further data files, one per line
+    string fileList;
     string mapFile;
     int snapnum;
     vector<int> user_snapnums;
@@ -50,6 +182,60 @@ int main (int argc, const char * argv[])
 
     float hubble_h;
 
+    // optional filter expression for selecting rows
+    string whereExpr;
+    // optional value ranges (column:min:max), e.g. for subvolumes
+    vector<string> rangeSpecs;
+    string zoneMapFile;
+    // optional report file for column statistics
+    string statsFile;
+    // optional aggregations written as CSV (file:kind:...)
+    vector<string> aggregateSpecs;
+    int aggregateThreads;
+    // optional checksums of the ingested values, and checksum files to verify the table with
+    string checksumFile;
+    vector<string> verifyFiles;
+    // write an ingest-optimised copy of the data files instead of ingesting
+    string repackFile;
+    vector<string> repackMaps;
+    long repackChunkRows;
+    int repackDeflate;
+    bool repackConvert;
+    // optional record of ingested outputs, for skipping them next time
+    string manifestFile;
+    // HDF5 driver and cache settings for the storage system
+    string ioProfile;
+    long ioCacheSize;
+    // further tables (fieldmap:table) filled from the same read pass
+    vector<string> targetSpecs;
+    // tables for the rows fulfilling a condition (table:condition)
+    vector<string> routeSpecs;
+    // optional deterministic sample of the rows (fraction[,seed])
+    string sampleSpec;
+    double sampleFraction;
+    unsigned long sampleSeed;
+    // optional part k/N of the rows of each output, for parallel ingests
+    string partitionSpec;
+    int partitionIndex;
+    int numPartitions;
+    // long-running server for many ingest jobs, or a command sent to it
+    bool daemon;
+    string daemonSocket;
+    int workers;
+    string sendCommand;
+
+    // work units (file, snapnum) shared by several processes
+    string queueDir;
+    bool queueInit;
+    int leaseTimeout;
+    int maxAttempts;
+
+    // ingest outputs while the data file is still being written
+    bool follow;
+    int pollInterval;
+    int followTimeout;
+    long followOutputs;
+
     // allow to use only some part of the data file,
     // i.e. specify offset and maximum number of rows:
     int startRow;
@@ -67,6 +253,26 @@ int main (int argc, const char * argv[])
     uint32_t bufferSize;
     uint32_t outputFreq;
 
+    // automatic tuning of the buffer size
+    bool autoTune;
+    uint32_t minBufferSize;
+    uint32_t maxBufferSize;
+    int tuneBatches;
+
+    // reading in a separate thread
+    bool pipeline;
+    int queueBatches;
+    long batchRows;
+
+    // order of rows inside each output
+    string sortBy;
+    int sortThreads;
+
+    // node-major output (history of each node)
+    bool history;
+    string historyDir;
+    long historyMemory;
+
 //    bool greedyDelim;
     bool isDryRun = false;
     bool resumeMode;
@@ -99,13 +305,26 @@ int main (int argc, const char * argv[])
     dbSystemDesc.append(") - [default: mysql]");
 
 
-    po::options_description progDesc("GalacticusIngest - Ingest binary HDF5 Galacticus files into databases\n\nGalacticusIngest [OPTIONS] [dataFile]\n\nCommand line options:");
+    po::options_description progDesc("GalacticusIngest - Ingest binary HDF5 Galacticus files into databases\n\nGalacticusIngest [OPTIONS] [dataFile ...]\n\nCommand line options:");
 
     progDesc.add_options()
                 ("help,?", "output help")
-                ("data,d", po::value<string>(&dataFile), "datafile to ingest")
+                ("data,d", po::value<vector<string> >(&dataFiles)->multitoken(), "datafile(s) to ingest; several files (e.g. one per MPI process) are read as one, with consecutive row numbers per output")
+                ("fileList", po::value<string>(&fileList)->default_value(""), "file with the names of (further) data files to ingest as one, one per line")
                 ("system,s", po::value<string>(&system)->default_value("mysql"), dbSystemDesc.c_str())
                 ("bufferSize,B", po::value<uint32_t>(&bufferSize)->default_value(128), "ingest buffer size (will be reduced to sytem maximum if needed) [default: 128]")
+                ("autoTune", po::value<bool>(&autoTune)->default_value(0), "adjust the buffer size automatically, based on the measured ingest rate? [default: 0]")
+                ("minBufferSize", po::value<uint32_t>(&minBufferSize)->default_value(16), "smallest buffer size used for auto-tuning [default: 16]")
+                ("maxBufferSize", po::value<uint32_t>(&maxBufferSize)->default_value(8192), "largest buffer size used for auto-tuning [default: 8192]")
+                ("tuneBatches", po::value<int>(&tuneBatches)->default_value(50), "number of batches ingested before the buffer size is adjusted again [default: 50]")
+                ("pipeline", po::value<bool>(&pipeline)->default_value(0), "read the data file in a separate thread, parallel to the database inserts? [default: 0]")
+                ("queueBatches", po::value<int>(&queueBatches)->default_value(8), "number of row batches passed between reader thread and database inserts in pipelined mode [default: 8]")
+                ("batchRows", po::value<long>(&batchRows)->default_value(4096), "number of rows per batch in pipelined mode [default: 4096]")
+                ("sortBy", po::value<string>(&sortBy)->default_value(""), "ingest the rows of each output sorted by this column (dataset name or depthFirstId), e.g. for tables with a clustered index [default: file order]")
+                ("sortThreads", po::value<int>(&sortThreads)->default_value(4), "number of threads for sorting [default: 4]")
+                ("history", po::value<bool>(&history)->default_value(0), "ingest the rows sorted by nodeIndex and snapnum (history of each node) instead of output by output? [default: 0]")
+                ("historyDir", po::value<string>(&historyDir)->default_value("."), "directory for temporary bucket files in history mode [default: .]")
+                ("historyMemory", po::value<long>(&historyMemory)->default_value(1024), "memory (MB) for sorting one bucket in history mode [default: 1024]")
                 ("outputFreq,F", po::value<uint32_t>(&outputFreq)->default_value(100000), "number of rows after which a performance measurement is output [default: 100000]")
                 ("dbase,D", po::value<string>(&dbase)->default_value(""), "name of the database where the data is added to (where applicable)")
                 ("table,T", po::value<string>(&table)->default_value(""), "name of the table where the data is added to")
@@ -126,6 +345,38 @@ int main (int argc, const char * argv[])
 //                ("snapnum", po::value<int32_t>(&user_snapnum)->default_value(-1), "only read data for given snaphot number? [default: -1 = read all]")
 //                ("output", po::value<int32_t>(&user_output)->default_value(-1), "only read data for given snaphot number? [default: -1]")
                 ("snapnums", po::value<vector<int32_t> >(&user_snapnums)->multitoken(), "read data for given snaphot numbers? [default: read all available snapnums]")
+                ("where", po::value<string>(&whereExpr)->default_value(""), "only ingest rows fulfilling this expression on dataset columns, e.g. 'diskMassStellar*h > 1e9 && satelliteStatus == 0' [default: ingest all rows]")
+                ("range", po::value<vector<string> >(&rangeSpecs), "only ingest rows with column values in the given range, format column:min:max; can be given several times, e.g. for a box in positionPositionX/Y/Z; chunks outside the ranges are skipped using zone maps")
+                ("zoneMapFile", po::value<string>(&zoneMapFile)->default_value(""), "file for storing the zone maps (min/max per chunk) used for ranges [default: dataFile.zonemap]")
+                ("statsFile", po::value<string>(&statsFile)->default_value(""), "write statistics (count, nulls, NaN/Inf, min, max, sum, quantiles, histogram) of all ingested columns per snapnum to this JSON file [default: no statistics]")
+                ("aggregate", po::value<vector<string> >(&aggregateSpecs), "compute an aggregation of the ingested rows per snapnum while reading and write it to a CSV file, given as file:count, file:sum:column, file:hist:column:min:max:nbins[:log] or file:grid:ngrid:boxSize[:column] (can be repeated), e.g. 'smf.csv:hist:diskMassStellar:1e6:1e13:35:log'")
+                ("aggregateThreads", po::value<int>(&aggregateThreads)->default_value(4), "number of threads for computing aggregations [default: 4]")
+                ("checksumFile", po::value<string>(&checksumFile)->default_value(""), "write checksums (rows, non-NULL values, sum, XOR) of all ingested columns per fileNum and snapnum to this file, for checking the table later with --verify [default: no checksums]")
+                ("verify", po::value<vector<string> >(&verifyFiles), "instead of ingesting, compare the given checksum file(s) with aggregate queries on the table given by -D and -T (can be repeated, e.g. one file per process; only for mysql)")
+                ("repack", po::value<string>(&repackFile)->default_value(""), "instead of ingesting, write a copy of the data files to this HDF5 file with only the datasets needed by the field map(s), names without redshift and large chunks, for faster ingests later [default: no repacking]")
+                ("repackMap", po::value<vector<string> >(&repackMaps), "further field map whose datasets shall be kept when repacking (can be repeated)")
+                ("repackChunkRows", po::value<long>(&repackChunkRows)->default_value(1048576), "number of rows per chunk of the repacked datasets [default: 1048576]")
+                ("repackDeflate", po::value<int>(&repackDeflate)->default_value(0), "deflate level (0-9, with shuffle filter) of the repacked datasets [default: 0 = no compression]")
+                ("repackConvert", po::value<bool>(&repackConvert)->default_value(0), "apply the unit conversions for the given hubble_h when repacking, so that they are not needed when ingesting? [default: 0]")
+                ("manifest", po::value<string>(&manifestFile)->default_value(""), "record completely ingested outputs in this file and skip the outputs recorded there already, unless the mapping has changed; changed outputs are refused [default: no manifest]")
+                ("follow", po::value<bool>(&follow)->default_value(0), "follow a data file that is still being written: ingest each output as soon as the next one appears, until the run is complete (see --followTimeout, --followOutputs)? [default: 0]")
+                ("pollInterval", po::value<int>(&pollInterval)->default_value(60), "seconds between checks for new outputs in follow mode [default: 60]")
+                ("followTimeout", po::value<int>(&followTimeout)->default_value(86400), "regard the run as complete, if no new output appeared for this number of seconds [default: 86400]")
+                ("followOutputs", po::value<long>(&followOutputs)->default_value(0), "regard the run as complete, when this number of outputs exists [default: 0 = use timeout only]")
+                ("daemon", po::value<bool>(&daemon)->default_value(0), "run as daemon: accept ingest jobs (and status requests) on a local Unix socket, using the database options, -f, -T, -B, --hubble_h and --ioProfile as defaults for the jobs? [default: 0]")
+                ("daemonSocket", po::value<string>(&daemonSocket)->default_value("/tmp/GalacticusIngest.sock"), "Unix socket of the daemon [default: /tmp/GalacticusIngest.sock]")
+                ("workers", po::value<int>(&workers)->default_value(4), "number of jobs the daemon runs in parallel [default: 4]")
+                ("send", po::value<string>(&sendCommand)->default_value(""), "send this command (e.g. 'status') to a running daemon and print the answer")
+                ("ioProfile", po::value<string>(&ioProfile)->default_value("default"), "HDF5 access settings for the storage system: default, core (load files into memory), lustre (large buffers and chunk cache, readahead hints) or paged (page buffer, for files with paged file space) [default: default]")
+                ("ioCacheSize", po::value<long>(&ioCacheSize)->default_value(256), "maximum chunk cache per dataset and page buffer size in MB for the lustre and paged I/O profiles [default: 256]")
+                ("target", po::value<vector<string> >(&targetSpecs), "insert the rows also into another table, given as fieldmap:table (can be repeated); each output is read only once for all tables, each table gets its own database connection [default: only -T]")
+                ("route", po::value<vector<string> >(&routeSpecs), "insert the rows fulfilling a condition into another table, given as table:condition, e.g. 'Centrals:satelliteStatus == 0' or 'Galacticus_26_40:snapnum >= 26 && snapnum <= 40' (can be repeated); rows fulfilling no condition go to -T [default: no routes]")
+                ("sample", po::value<string>(&sampleSpec)->default_value(""), "ingest only a sample of the rows, given as fraction[,seed], e.g. 0.01 for 1%; rows are chosen by a hash of their dbId, so the sample is the same in each run [default: all rows]")
+                ("partition", po::value<string>(&partitionSpec)->default_value(""), "ingest only part k of N (given as k/N) of the rows of each output, e.g. for running N processes in parallel; dbIds are the same as for a complete ingest [default: all rows]")
+                ("queueDir", po::value<string>(&queueDir)->default_value(""), "directory on a shared file system with work units (one per data file and snapnum); ingest units from there until all are done [default: no queue]")
+                ("queueInit", po::value<bool>(&queueInit)->default_value(0), "add work units for the given data files (fileNum, fileNum+1, ...) and snapnums to --queueDir instead of ingesting? [default: 0]")
+                ("leaseTimeout", po::value<int>(&leaseTimeout)->default_value(600), "seconds after which a claimed work unit of a process that stopped renewing it is taken over [default: 600]")
+                ("maxAttempts", po::value<int>(&maxAttempts)->default_value(3), "number of processes that may claim a work unit, before a unit whose processes all stopped (e.g. crashed) is moved to failed/ [default: 3]")
                 ("resumeMode,R", po::value<bool>(&resumeMode)->default_value(0), "try to resume ingest on failed connection (turns off transactions)? [default: 0]")
                 ("validateSchema,v", po::value<bool>(&askUserToValidateRead)->default_value(1), "ask user to validate the schema mapping [default: 1]")
                 ;
@@ -134,7 +385,7 @@ int main (int argc, const char * argv[])
     // required options: dbase, table, mapFile, fileNum
 
     po::positional_options_description posDesc;
-    posDesc.add("data", 1);
+    posDesc.add("data", -1);
 
     //read out the options
     po::variables_map varMap;
@@ -143,15 +394,139 @@ int main (int argc, const char * argv[])
     // --> only compiles at erebos if I include the (char **) cast
     po::notify(varMap);
 
-    if (varMap.count("help") || varMap.count("?") || dataFile.length() == 0) {
+    if (fileList != "") {
+        ifstream listStream(fileList.c_str());
+        string line;
+        if (!listStream.is_open()) {
+            cout << "ERROR: Cannot open file list " << fileList << endl;
+            return EXIT_FAILURE;
+        }
+        while (getline(listStream, line)) {
+            if (line.length() > 0 && line[0] != '#') {
+                dataFiles.push_back(line);
+            }
+        }
+    }
+
+    if (sendCommand != "") {
+        return sendDaemonCommand(daemonSocket, sendCommand);
+    }
+
+    if (varMap.count("help") || varMap.count("?") || (dataFiles.size() == 0 && !daemon && verifyFiles.size() == 0 && (queueDir == "" || queueInit))) {
         cout << progDesc;
         return EXIT_SUCCESS;
     }
 
+    IngestSettings settings;
+    settings.system = system;
+    settings.dbase = dbase;
+    settings.table = table;
+    settings.mapFile = mapFile;
+    settings.user = user;
+    settings.pwd = pwd;
+    settings.port = port;
+    settings.host = host;
+    settings.socket = socket;
+    settings.path = path;
+    settings.bufferSize = bufferSize;
+    settings.outputFreq = outputFreq;
+    settings.resumeMode = resumeMode;
+    settings.isDryRun = isDryRun;
+    settings.hubble_h = hubble_h;
+    settings.ioProfile = ioProfile;
+    settings.ioCacheSize = ioCacheSize;
+
+    if (verifyFiles.size() > 0) {
+        return verifyChecksums(verifyFiles, settings);
+    }
+
+    if (daemon) {
+        string ignored = getGivenOptions(varMap, queueIgnoredOptions);
+        if (whereExpr != "") {
+            ignored += (ignored != "") ? ", --where" : "--where";
+        }
+        if (ignored != "") {
+            cout << "ERROR: " << ignored << " cannot be used with --daemon, jobs only take database, field map, -h and I/O settings as defaults (and where= per job)." << endl;
+            return EXIT_FAILURE;
+        }
+        IngestDaemon ingestDaemon(daemonSocket, workers, settings);
+        return ingestDaemon.run();
+    }
+
+    if (queueDir != "") {
+        WorkQueue workQueue(queueDir, leaseTimeout, maxAttempts);
+        if (queueInit) {
+            return workQueue.init(dataFiles, fileNum, user_snapnums);
+        }
+        if (getGivenOptions(varMap, queueIgnoredOptions) != "") {
+            cout << "ERROR: " << getGivenOptions(varMap, queueIgnoredOptions) << " cannot be used with --queueDir, only --where is passed to the work units." << endl;
+            return EXIT_FAILURE;
+        }
+        return workQueue.work(settings, whereExpr);
+    }
+
+    sampleFraction = 1;
+    sampleSeed = 0;
+    if (sampleSpec != "") {
+        char *end;
+        sampleFraction = strtod(sampleSpec.c_str(), &end);
+        if (*end == ',') {
+            sampleSeed = strtoul(end + 1, &end, 10);
+        }
+        if (*end != '\0' || sampleFraction <= 0 || sampleFraction > 1) {
+            cout << "ERROR: Invalid sample " << sampleSpec << ", expected fraction[,seed] with 0 < fraction <= 1." << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    partitionIndex = 1;
+    numPartitions = 1;
+    if (partitionSpec != "") {
+        char rest;
+        if (sscanf(partitionSpec.c_str(), "%d/%d%c", &partitionIndex, &numPartitions, &rest) != 2
+            || numPartitions < 1 || partitionIndex < 1 || partitionIndex > numPartitions) {
+            cout << "ERROR: Invalid partition " << partitionSpec << ", expected k/N with 1 <= k <= N." << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((targetSpecs.size() > 0 || routeSpecs.size() > 0) && (history || pipeline || autoTune || checksumFile != "")) {
+        cout << "ERROR: --target and --route cannot be combined with history mode, --pipeline, --autoTune or --checksumFile." << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (repackFile != "" && (whereExpr != "" || rangeSpecs.size() > 0 || sampleFraction < 1 || numPartitions > 1
+                             || sortBy != "" || aggregateSpecs.size() > 0 || targetSpecs.size() > 0 || routeSpecs.size() > 0
+                             || follow || manifestFile != "")) {
+        // all rows in file order are needed, so that the dbIds stay the same
+        cout << "ERROR: --repack cannot be combined with --where, --range, --sample, --partition, --sortBy, --aggregate, --target, --route, --follow or --manifest." << endl;
+        return EXIT_FAILURE;
+    }
+    if (repackFile != "" && (repackChunkRows < 1 || repackDeflate < 0 || repackDeflate > 9)) {
+        cout << "ERROR: Invalid --repackChunkRows or --repackDeflate." << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (history && (pipeline || autoTune)) {
+        cout << "ERROR: History mode cannot be combined with --pipeline or --autoTune." << endl;
+        return EXIT_FAILURE;
+    }
+
     cout << "You have entered the following parameters:" << endl;
-    cout << "Data file: " << dataFile << endl;
+    for (size_t i=0; i<dataFiles.size(); i++) {
+        cout << "Data file: " << dataFiles[i] << endl;
+    }
     cout << "DB system: " << system << endl;
     cout << "Buffer size: " << bufferSize << endl;
+    if (autoTune) {
+        cout << "Auto-tuning buffer size between " << minBufferSize << " and " << maxBufferSize << ", every " << tuneBatches << " batches" << endl;
+    }
+    if (pipeline) {
+        cout << "Pipelined reading with " << queueBatches << " batches of " << batchRows << " rows" << endl;
+    }
+    if (history) {
+        cout << "History mode, temporary files in " << historyDir << ", using " << historyMemory << " MB per bucket" << endl;
+    }
     cout << "Performance output frequency: " << outputFreq << endl;
     cout << "Database name: " << dbase << endl;
     cout << "Table name: " << table << endl;
@@ -174,6 +549,46 @@ int main (int argc, const char * argv[])
         }
         cout << endl;
     }
+    if (whereExpr != "") {
+        cout << "Filter: " << whereExpr << endl;
+    }
+    for (size_t i=0; i<rangeSpecs.size(); i++) {
+        cout << "Range: " << rangeSpecs[i] << endl;
+    }
+    if (sortBy != "") {
+        cout << "Sort rows by: " << sortBy << endl;
+    }
+    for (size_t i=0; i<aggregateSpecs.size(); i++) {
+        cout << "Aggregate: " << aggregateSpecs[i] << endl;
+    }
+    for (size_t i=0; i<targetSpecs.size(); i++) {
+        cout << "Further target: " << targetSpecs[i] << endl;
+    }
+    if (ioProfile != "default") {
+        cout << "I/O profile: " << ioProfile << endl;
+    }
+    if (sampleFraction < 1) {
+        cout << "Sample: " << sampleFraction << " of the rows, seed " << sampleSeed << endl;
+    }
+    if (numPartitions > 1) {
+        cout << "Partition: " << partitionIndex << " of " << numPartitions << endl;
+    }
+    if (checksumFile != "") {
+        cout << "Checksum file: " << checksumFile << endl;
+    }
+    if (manifestFile != "") {
+        cout << "Manifest: " << manifestFile << endl;
+    }
+    if (repackFile != "") {
+        cout << "Repack into: " << repackFile << ", " << repackChunkRows << " rows per chunk, deflate level " << repackDeflate;
+        if (repackConvert) {
+            cout << ", with converted units";
+        }
+        cout << endl;
+    }
+    if (follow) {
+        cout << "Following the data files, checking every " << pollInterval << " s for new outputs" << endl;
+    }
 
     cout << endl;
 
@@ -182,7 +597,51 @@ int main (int argc, const char * argv[])
     DBConverter::ConverterFactory * convFac = new DBConverter::ConverterFactory;
 
     //now setup the file reader
-    GalacticusReader *thisReader = new GalacticusReader(dataFile, fileNum, user_snapnums, hubble_h);
+    GalacticusReader *thisReader = new GalacticusReader(dataFiles, fileNum, user_snapnums, hubble_h);
+    if (whereExpr != "") {
+        thisReader->setFilter(whereExpr);
+    }
+    thisReader->setZoneMapFile(zoneMapFile);
+    for (size_t i=0; i<rangeSpecs.size(); i++) {
+        thisReader->addRange(rangeSpecs[i]);
+    }
+    if (statsFile != "") {
+        thisReader->setStatsFile(statsFile);
+    }
+    if (sortBy != "") {
+        thisReader->setSortKey(sortBy, sortThreads);
+    }
+    for (size_t i=0; i<aggregateSpecs.size(); i++) {
+        thisReader->addAggregate(aggregateSpecs[i], aggregateThreads);
+    }
+    if (ioProfile != "default") {
+        thisReader->setIOProfile(ioProfile, ioCacheSize * 1048576);
+    }
+    if (sampleFraction < 1) {
+        thisReader->setSample(sampleFraction, sampleSeed);
+    }
+    if (numPartitions > 1) {
+        thisReader->setPartition(partitionIndex, numPartitions);
+    }
+    if (follow) {
+        thisReader->setFollow(pollInterval, followTimeout, followOutputs);
+    }
+    IngestManifest *manifest = NULL;
+    if (manifestFile != "") {
+        // everything that changes the ingested rows or values
+        stringstream options;
+        options << "h=" << hubble_h << " where=" << whereExpr;
+        for (size_t i=0; i<rangeSpecs.size(); i++) {
+            options << " range=" << rangeSpecs[i];
+        }
+        if (sampleFraction < 1) {
+            options << " sample=" << sampleFraction << "," << sampleSeed;
+        }
+        stringstream partition;
+        partition << partitionIndex << "/" << numPartitions;
+        manifest = new IngestManifest(manifestFile, dbase + string(".") + table, partition.str(), mapFile, options.str());
+        thisReader->setManifest(manifest);
+    }
     dbServer = adaptorFac.getDBAdaptors(system);
 
     //vector<string> dataSetNames;
@@ -193,8 +652,37 @@ int main (int argc, const char * argv[])
     cout << "Mapping file: " << mapFile << endl;
     thisSchemaMapper->readMappingFile(mapFile);
 
+    if (repackFile != "") {
+        Repacker repacker(thisReader, repackFile, repackChunkRows, repackDeflate, repackConvert);
+        repacker.addFieldMap(thisSchemaMapper->getDataFileFieldNames());
+        for (size_t i=0; i<thisSchemaMapper->getAssertions().size(); i++) {
+            repacker.addRawColumn(thisSchemaMapper->getAssertions()[i].first);
+        }
+        for (size_t i=0; i<repackMaps.size(); i++) {
+            GalacticusSchemaMapper repackMapper(assertFac, convFac);
+            cout << "Mapping file: " << repackMaps[i] << endl;
+            repackMapper.readMappingFile(repackMaps[i]);
+            repacker.addFieldMap(repackMapper.getDataFileFieldNames());
+            for (size_t j=0; j<repackMapper.getAssertions().size(); j++) {
+                repacker.addRawColumn(repackMapper.getAssertions()[j].first);
+            }
+        }
+        int numRepacked = repacker.run();
+        delete thisSchemaMapper;
+        return (numRepacked < 0) ? EXIT_FAILURE : 0;
+    }
+
+    vector<pair<string, string> > assertions = thisSchemaMapper->getAssertions();
+    for (size_t i=0; i<assertions.size(); i++) {
+        cout << "Assertion: " << assertions[i].first << " " << assertions[i].second << endl;
+        thisReader->addAssertion(assertions[i].first, assertions[i].second);
+    }
+
     DBDataSchema::Schema * thisSchema;
     thisSchema = thisSchemaMapper->generateSchema(dbase, table);
+    if (checksumFile != "") {
+        thisReader->setChecksumFile(checksumFile, thisSchema);
+    }
 
     /*cout << "complete schema: " << endl;
     for (int j=0; j<thisSchema->getArrSchemaItems().size(); j++) {
@@ -202,42 +690,32 @@ int main (int argc, const char * argv[])
     }
     */
 
-    galacticusIngestor = new DBIngest::DBIngestor(thisSchema, thisReader, dbServer);
-    galacticusIngestor->setUsrName(user);
-    galacticusIngestor->setPasswd(pwd);
-
-    //settings for different DBs (copy&paste from AsciiIngest)
-    if(system.compare("mysql") == 0) {
-        galacticusIngestor->setSocket(socket);
-        galacticusIngestor->setPort(port);
-        galacticusIngestor->setHost(host);
-    } else if (system.compare("sqlite3") == 0) {
-        galacticusIngestor->setHost(path);
-    } else if (system.compare("unix_sqlsrv_odbc") == 0) {
-        galacticusIngestor->setSocket("DRIVER=FreeTDS;TDS_Version=7.0;");
-        //galacticusIngestor->setSocket("DRIVER=SQL Server Native Client 10.0;");
-        galacticusIngestor->setPort(port);
-        galacticusIngestor->setHost(host);
-    } else if (system.compare("sqlsrv_odbc") == 0) {
-        galacticusIngestor->setSocket("DRIVER=SQL Server Native Client 10.0;");
-        galacticusIngestor->setPort(port);
-        galacticusIngestor->setHost(host);
-    } else if (system.compare("sqlsrv_odbc_bulk") == 0) {
-        //TESTS ON SQL SERVER SHOWED THIS IS VERY SLOW. BUT NO CLUE WHY, DID NOT BOTHER TO LOOK AT PROFILER YET
-        galacticusIngestor->setSocket("DRIVER=SQL Server Native Client 10.0;");
-        galacticusIngestor->setPort(port);
-        galacticusIngestor->setHost(host);
-    }  else if (system.compare("cust_odbc") == 0) {
-        galacticusIngestor->setSocket(socket);
-        galacticusIngestor->setPort(port);
-        galacticusIngestor->setHost(host);
-    } else if (system.compare("cust_odbc_bulk") == 0) {
-        //TESTS ON SQL SERVER SHOWED THIS IS VERY SLOW. BUT NO CLUE WHY, DID NOT BOTHER TO LOOK AT PROFILER YET
-        galacticusIngestor->setSocket(socket);
-        galacticusIngestor->setPort(port);
-        galacticusIngestor->setHost(host);
+    if (targetSpecs.size() > 0 || routeSpecs.size() > 0) {
+        int numFailed = ingestFanOut(thisReader, thisSchema, settings, targetSpecs, routeSpecs, assertFac, convFac, queueBatches, batchRows);
+        if (manifest) {
+            if (!isDryRun && numFailed == 0) {
+                manifest->save();
+            }
+            delete manifest;
+        }
+        delete thisSchemaMapper;
+        delete thisSchema;
+        return (numFailed == 0 && thisReader->getNumFailedOutputs() == 0) ? 0 : EXIT_FAILURE;
     }
-    
+
+    PipelineReader *pipelineReader = NULL;
+    HistoryReader *historyReader = NULL;
+    if (history) {
+        historyReader = new HistoryReader(thisReader, thisSchema, historyDir, historyMemory * 1024 * 1024);
+        galacticusIngestor = new DBIngest::DBIngestor(thisSchema, historyReader, dbServer);
+    } else if (pipeline) {
+        pipelineReader = new PipelineReader(thisReader, thisSchema, queueBatches, batchRows);
+        galacticusIngestor = new DBIngest::DBIngestor(thisSchema, pipelineReader, dbServer);
+    } else {
+        galacticusIngestor = new DBIngest::DBIngestor(thisSchema, thisReader, dbServer);
+    }
+    applyConnectionSettings(galacticusIngestor, settings);
+
     // setup resume option, if desired
     galacticusIngestor->setResumeMode(resumeMode); 
     galacticusIngestor->setIsDryRun(isDryRun);
@@ -248,13 +726,61 @@ int main (int argc, const char * argv[])
     //now ingest data after setup
     galacticusIngestor->setPerformanceMeter(outputFreq);	// after how many lines should I print the status?
     cout << "Go now!" << endl;
-    galacticusIngestor->ingestData(bufferSize);  		// buffer size (in bytes??)
+    string ingestError = "";
+    try {
+        if (autoTune) {
+            BatchTuner tuner(bufferSize, minBufferSize, maxBufferSize, tuneBatches);
+            if (pipeline) {
+                ingestAutoTuned(galacticusIngestor, pipelineReader, tuner);
+            } else {
+                ingestAutoTuned(galacticusIngestor, thisReader, tuner);
+            }
+        } else {
+            galacticusIngestor->ingestData(bufferSize);  		// buffer size (in bytes??)
+        }
+    } catch (std::exception &e) {
+        ingestError = e.what();
+    } catch (H5::Exception &e) {
+        ingestError = e.getDetailMsg();
+    } catch (...) {
+        ingestError = "unknown error";
+    }
     
+    // stops the reader thread in pipelined mode (also after an error)
+    if (pipelineReader) {
+        delete pipelineReader;
+    }
+    if (historyReader) {
+        delete historyReader;
+    }
+
+    if (ingestError != "") {
+        // the outputs read so far are not recorded in the manifest
+        cout << "ERROR: Ingest failed: " << ingestError << endl;
+        delete manifest;
+        delete thisSchemaMapper;
+        delete thisSchema;
+        return EXIT_FAILURE;
+    }
+
+    // all rows are in the database now
+    if (manifest) {
+        if (!isDryRun) {
+            manifest->save();
+        }
+        delete manifest;
+    }
+
     delete thisSchemaMapper;
     delete thisSchema;
     //delete assertFac;
     //delete convFac;
 
+    // outputs with failed assertions were skipped
+    if (thisReader->getNumFailedOutputs() > 0) {
+        return EXIT_FAILURE;
+    }
+
     return 0;
 }
 
@@ -0,0 +1,151 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Checks of the --where row filter: operator precedence, components
+// of multi-dimensional datasets and evaluation with candidate rows.
+// Returns a non-zero exit code if any check fails.
+
+#include <iostream>
+#include <vector>
+
+#include "Galacticus_Filter.h"
+
+using namespace std;
+using namespace Galacticus;
+
+static int numFailed = 0;
+
+static void check(bool ok, const string what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        numFailed++;
+    }
+}
+
+static bool sameRows(const vector<long> &rows, const long *expected, long n) {
+    if ((long) rows.size() != n) {
+        return false;
+    }
+    for (long i=0; i<n; i++) {
+        if (rows[i] != expected[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void checkRows(const string expression, const long *expected, long n) {
+    // rows 0..3 of the columns a, b, c, x, y
+    double a[] = {1, 10, 1, 2};
+    double b[] = {2, 3, 2, 3};
+    long c[] = {4, 2, 5, 0};
+    double x[] = {2, -1, -1, 0.5};
+    double y[] = {0, 0, 6, 6};
+    vector<long> selection;
+
+    RowFilter f;
+    f.setConstant("h", 0.5);
+    f.parse(expression);
+    vector<string> columns = f.getColumnNames();
+    for (size_t i=0; i<columns.size(); i++) {
+        if (columns[i] == "a") f.bindColumn(i, a, NULL);
+        else if (columns[i] == "b") f.bindColumn(i, b, NULL);
+        else if (columns[i] == "c") f.bindColumn(i, NULL, c);
+        else if (columns[i] == "x") f.bindColumn(i, x, NULL);
+        else if (columns[i] == "y") f.bindColumn(i, y, NULL);
+    }
+    f.evaluate(4, selection);
+    check(sameRows(selection, expected, n), expression);
+}
+
+int main(int argc, char *argv[]) {
+    // * before +, i.e. 1 + 2*4 = 9 (and not 12)
+    long r1[] = {1, 2};
+    checkRows("a + b*c > 10", r1, 2);
+    // left-associative: 10 - 3 - 2 = 5
+    long r2[] = {1};
+    checkRows("a - b - c == 5", r2, 1);
+    long r3[] = {0, 2};
+    checkRows("a / b / 0.125 == 4", r3, 2);
+    // && before ||
+    long r4[] = {0, 2};
+    checkRows("x > 1 || x < 0 && y > 5", r4, 2);
+    long r5[] = {2};
+    checkRows("(x > 1 || x < 0) && y > 5", r5, 1);
+    // comparisons after arithmetic, unary minus and ! before all
+    long r6[] = {0};
+    checkRows("-x*2 < -3", r6, 1);
+    long r7[] = {1, 2, 3};
+    checkRows("!(x > 1)", r7, 3);
+    long r8[] = {0, 1, 2, 3};
+    checkRows("!x < 1", r8, 4);
+    // functions and constants
+    long r10[] = {0, 3};
+    checkRows("x*h >= 0.25", r10, 2);
+    long r9[] = {1};
+    checkRows("log10(a) == 1 && sqrt(abs(-c)) > 1", r9, 1);
+
+    // components of N x 3 datasets are separate columns, given with their index
+    {
+        RowFilter f("velocity[1] > 0 && velocity[0] + velocity[12] < 1 && velocity[1] < 5");
+        vector<string> columns = f.getColumnNames();
+        check(columns.size() == 3, "number of component columns");
+        check(columns.size() == 3 && columns[0] == "velocity[1]" && columns[1] == "velocity[0]" && columns[2] == "velocity[12]",
+              "names of component columns");
+
+        double v0[] = {0, 0, 1};
+        double v1[] = {1, -1, 1};
+        long v12[] = {0, 0, 0};
+        f.bindColumn(0, v1, NULL);
+        f.bindColumn(1, v0, NULL);
+        f.bindColumn(2, NULL, v12);
+        vector<long> selection;
+        f.evaluate(3, selection);
+        long expected[] = {0};
+        check(sameRows(selection, expected, 1), "values of component columns");
+    }
+
+    // dataset names with colons are one identifier
+    {
+        RowFilter f("totalLuminositiesStellar:SDSS_g:observed > 1");
+        check(f.getColumnNames().size() == 1 && f.getColumnNames()[0] == "totalLuminositiesStellar:SDSS_g:observed",
+              "column name with colons");
+    }
+
+    // candidate rows with columns that hold only the rows from 100 on,
+    // as read for a partition
+    {
+        RowFilter f("m >= 2");
+        double m[] = {1, 2, 3, 0, 5};
+        f.bindColumn(0, m, NULL, 100);
+        long rows[] = {101, 102, 103, 104};
+        vector<long> candidates(rows, rows + 4);
+        vector<long> selection;
+        f.evaluate(candidates, selection);
+        long expected[] = {101, 102, 104};
+        check(sameRows(selection, expected, 3), "candidate rows with offset");
+    }
+
+    if (numFailed > 0) {
+        cout << numFailed << " checks failed." << endl;
+        return 1;
+    }
+    cout << "All filter checks passed." << endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Checks of the sort keys and the radix sort used for --sortBy: order of
+// negative numbers, -0, infinities and NaN, and a stable sort (also with
+// several threads). Returns a non-zero exit code if any check fails.
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+
+#include "Galacticus_RadixSort.h"
+
+using namespace std;
+using namespace Galacticus;
+
+static int numFailed = 0;
+
+static void check(bool ok, const string what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        numFailed++;
+    }
+}
+
+static bool lessByKey(const pair<unsigned long, long> &a, const pair<unsigned long, long> &b) {
+    return a.first < b.first;
+}
+
+static void checkSort(long n, int nthreads, const string what) {
+    // compare with a stable sort of (key, row) pairs; few different keys,
+    // so that the order of equal keys is checked as well
+    vector<unsigned long> keys(n);
+    vector<long> rows(n);
+    vector<pair<unsigned long, long> > expected(n);
+
+    srand(42);
+    for (long i=0; i<n; i++) {
+        double v = (rand() % 2001 - 1000) * 0.5;
+        keys[i] = getSortableKey(v);
+        rows[i] = 3 * i;
+        expected[i] = make_pair(keys[i], rows[i]);
+    }
+    stable_sort(expected.begin(), expected.end(), lessByKey);
+
+    radixSortRows(keys, rows, nthreads);
+    bool ok = true;
+    for (long i=0; i<n; i++) {
+        if (keys[i] != expected[i].first || rows[i] != expected[i].second) {
+            ok = false;
+            break;
+        }
+    }
+    check(ok, what);
+}
+
+int main(int argc, char *argv[]) {
+    double inf = numeric_limits<double>::infinity();
+    double nan = numeric_limits<double>::quiet_NaN();
+    double values[] = {-inf, -1e300, -2.5, -1, -1e-300, 0, 1e-300, 1, 2.5, 1e300, inf};
+    int n = sizeof(values) / sizeof(values[0]);
+
+    for (int i=0; i+1<n; i++) {
+        check(getSortableKey(values[i]) < getSortableKey(values[i+1]), "order of double keys");
+    }
+    check(getSortableKey(-0.) == getSortableKey(0.), "-0 and +0 have the same key");
+    check(getSortableKey(-1e-300) < getSortableKey(-0.), "-0 after negative numbers");
+    check(getSortableKey(inf) < getSortableKey(nan), "NaN after +Inf");
+    check(getSortableKey(-nan) == getSortableKey(nan), "all NaNs have the same key");
+
+    long lvalues[] = {numeric_limits<long>::min(), -1000000000000L, -1, 0, 1, 1000000000000L, numeric_limits<long>::max()};
+    n = sizeof(lvalues) / sizeof(lvalues[0]);
+    for (int i=0; i+1<n; i++) {
+        check(getSortableKey(lvalues[i]) < getSortableKey(lvalues[i+1]), "order of integer keys");
+    }
+
+    checkSort(0, 1, "empty input");
+    checkSort(1000, 1, "stable sort");
+    // above the size from which threads are used
+    checkSort(1500000, 4, "stable sort with threads");
+
+    if (numFailed > 0) {
+        cout << numFailed << " checks failed." << endl;
+        return 1;
+    }
+    cout << "All radix sort checks passed." << endl;
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2015, Kristin Riebe <kriebe@aip.de>,
+ *                      eScience team AIP Potsdam
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  See the NOTICE file distributed with this work for additional
+ *  information regarding copyright ownership. You may obtain a copy
+ *  of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Checks of the tree index (forestId, depthFirstId): depth-first order of
+// the children in row order, nodes with unknown parents, and parent cycles
+// in broken data. Returns a non-zero exit code if any check fails.
+
+#include <iostream>
+#include <vector>
+
+#include "Galacticus_TreeIndex.h"
+
+using namespace std;
+using namespace Galacticus;
+
+static int numFailed = 0;
+
+static void check(bool ok, const string what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        numFailed++;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // row:              0  1  2  3   4   5   6   7   8   9
+    long nodeIndex[]   = {1, 2, 3, 4, 10, 11, 20, 21, 22, 30};
+    long parentIndex[] = {1, 1, 1, 2, -1, 10, 21, 20, 21, 30};
+    // rows 0-3:  tree with root 1 (its own parent), 4 is a child of 2
+    // rows 4-5:  root 10 (parent does not exist), child 11
+    // rows 6-8:  20 and 21 are each other's parent, 22 hangs off the cycle
+    // row 9:     single root
+    long n = 10;
+
+    long depthFirst[] = {0, 1, 3, 2, 4, 5, 7, 8, 9, 6};
+    long forest[]     = {0, 0, 0, 0, 4, 4, 7, 7, 7, 6};
+    long parentRow[]  = {-1, 0, 0, 1, -1, 4, 7, 6, 7, -1};
+
+    TreeIndex t;
+    t.build(nodeIndex, parentIndex, n);
+    check(t.isBuilt(), "index is built");
+
+    vector<int> seen(n, 0);
+    for (long i=0; i<n; i++) {
+        check(t.getParentRow(i) == parentRow[i], "parent row");
+        long d = t.getDepthFirstId(i);
+        check(d >= 0 && d < n, "depthFirstId inside 0 ... n-1");
+        if (d >= 0 && d < n) {
+            seen[d]++;
+        }
+    }
+    for (long i=0; i<n; i++) {
+        check(seen[i] == 1, "each depthFirstId is used once");
+    }
+
+    // real roots first in row order, then the rows of cycles
+    for (long i=0; i<n; i++) {
+        check(t.getDepthFirstId(i) == depthFirst[i], "depthFirstId");
+        check(t.getForestId(i) == forest[i], "forestId");
+    }
+
+    // a cycle without any root only must not hang or skip rows
+    {
+        long cycleIndex[] = {5, 6, 7};
+        long cycleParent[] = {7, 5, 6};
+        TreeIndex c;
+        c.build(cycleIndex, cycleParent, 3);
+        check(c.getDepthFirstId(0) == 0 && c.getDepthFirstId(1) == 1 && c.getDepthFirstId(2) == 2, "depthFirstId in a cycle");
+        check(c.getForestId(0) == 0 && c.getForestId(1) == 0 && c.getForestId(2) == 0, "forestId in a cycle");
+    }
+
+    // node lookup: missing keys, duplicates keep the first row
+    {
+        long keys[] = {7, 8, 7, -3};
+        NodeHash h;
+        check(h.isEmpty() && h.find(7) == -1, "empty hash");
+        h.build(keys, 4);
+        check(h.find(7) == 0 && h.find(8) == 1 && h.find(-3) == 3, "rows of node indices");
+        check(h.find(9) == -1, "missing node index");
+    }
+
+    t.clear();
+    check(!t.isBuilt() && t.nodeHash.isEmpty(), "index is cleared");
+
+    if (numFailed > 0) {
+        cout << numFailed << " checks failed." << endl;
+        return 1;
+    }
+    cout << "All tree index checks passed." << endl;
+    return 0;
+}